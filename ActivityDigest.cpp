@@ -7,16 +7,42 @@
 
 #include "ActivityDigest.h"
 
- retained int ActivityDigest::_active(-1);
- retained int ActivityDigest::_lastUploaded(-1);
  retained time_t ActivityDigest::_lastActivity(0);
- retained uint16_t ActivityDigest::_minutes[60*24];
+ retained uint8_t ActivityDigest::_minutes[60*24];
+ retained uint8_t ActivityDigest::_hours[DIGEST_HOUR_DAYS * 24];
+ retained uint8_t ActivityDigest::_days[DIGEST_DAYS];
+ retained DigestHead ActivityDigest::_minuteHead = { -1, 0 };
+ retained DigestHead ActivityDigest::_hourHead = { -1, 0 };
+ retained DigestHead ActivityDigest::_dayHead = { -1, 0 };
+ retained std::atomic<uint32_t> ActivityDigest::_changed[60*24 / 32];
 // retained ActivityDigest::ActiveMinute ActivityDigest::_minutes[60*24];
 
 ActivityDigest::ActivityDigest ()
- : _capacity(sizeof(_minutes) / sizeof(uint16_t))
+ : _minuteTier(_minutes, _minuteHead, 60)
+ , _hourTier(_hours, _hourHead, 60 * 60)
+ , _dayTier(_days, _dayHead, 24 * 60 * 60)
+ , _capacity(sizeof(_minutes))
  , _hunkSize(30)
+ , _unplacedTotal(0)
+ , _requested(0)
+ , _state(idle)
+ , _publishLeft(0)
+ , _publishStarted(0)
+ , _tokens(DIGEST_PUBLISH_BURST)
+ , _tokensAt(0)
 {
+  memset(_unplaced, 0, sizeof(_unplaced));
+  // a cold boot leaves garbage in the marks as in the tiers; nothing has changed yet
+  if (_minuteTier.newest() < 0)
+  {
+    for (unsigned int w = 0; w < sizeof(_changed) / sizeof(_changed[0]); w++)
+    {
+      _changed[w] = 0;
+    }
+  }
+  _minuteTier.begin();
+  _hourTier.begin();
+  _dayTier.begin();
 }
 
 ActivityDigest::~ActivityDigest ()
@@ -27,26 +53,119 @@ const int
 ActivityDigest::timeOffset() const
 {
   // Time class is missing some signatures to make this more straightforward, e.g. 'Time now; ... offset = now.hour() + ...' would be a mroe conventional way
-  time_t sinceEpoch = Time.now();
-  int offset = Time.hour(sinceEpoch) * 60 + Time.minute(sinceEpoch);
+  return timeOffset(Time.now());
+}
 
-  return offset;
+const int
+ActivityDigest::timeOffset(const time_t sinceEpoch) const
+{
+  return Time.hour(sinceEpoch) * 60 + Time.minute(sinceEpoch);
 }
 
 void
 ActivityDigest::registerActivity(const MotionEntry &motion)
 {
-  int offset = timeOffset();
-  if (_active == -1)
+  if (motion._epochUnknown)
   {
-    _active = offset;
-    _lastUploaded = offset;
-    // _lastActivity = now;
+    // no minute of the day to put it in yet
+    time_t minute = motion._time / 60;
+    if ((minute >= 0) && (minute < DIGEST_UNPLACED_MINUTES))
+    {
+      _unplaced[minute]++;
+      _unplacedTotal++;
+    }
+    else
+    {
+      Log.warn("rtc still unset %d minutes after power-up; activity not counted in digest", DIGEST_UNPLACED_MINUTES);
+    }
+    return;
   }
 
-  _minutes[offset]++;
-  _active = offset;
-  Log.info("minutes[%d] is now %d", offset, _minutes[offset]);
+  count(motion._time, 1);
+}
+
+void
+ActivityDigest::count(const time_t when, const uint16_t activity)
+{
+  int offset = timeOffset(when);
+  int32_t minute = _minuteTier.bucket(when);
+  int32_t newest = _minuteTier.newest();
+  int32_t last = (minute - 1 < newest + (int32_t) _capacity) ? minute - 1 : newest + (int32_t) _capacity;
+  bool counted;
+  uint32_t now;
+
+  // the minutes the ring moves past are cleared for the new day: whatever was unpublished in them is gone, and
+  // those that held activity changed, to none.  one already none may still owe the cloud that change from an
+  // earlier day, so its mark is left as it is.  only this thread writes the tiers, so they are read for that
+  // without masking interrupts; the ring is moved on an hour at a time, each in a short atomic block for the
+  // activity cloud function (see activity()), and an hour's minutes are marked once they are cleared, so a publish
+  // that takes a mark never sends the count from before
+  for (int32_t from = newest + 1; (newest >= 0) && (from <= last); from += 60)
+  {
+    int32_t to = (from + 59 < last) ? from + 59 : last;
+    uint64_t held = 0;
+
+    for (int32_t passed = from; passed <= to; passed++)
+    {
+      held |= (uint64_t) (_minuteTier.slot(passed % _capacity) != 0) << (passed - from);
+    }
+    ATOMIC_BLOCK()
+    {
+      _minuteTier.advance(to);
+    }
+    for (int32_t passed = from; passed <= to; passed++)
+    {
+      if ((held >> (passed - from)) & 1)
+      {
+	markChanged(passed % _capacity);
+      }
+    }
+  }
+
+  // every tier counts everything; each clears what it passes as the time moves on (the hour and day tiers a week
+  // and a month at most).  the minute is marked after it is counted, so a publish that takes the mark first sends
+  // the count again next time
+  ATOMIC_BLOCK()
+  {
+    counted = _minuteTier.add(when, activity);
+    (void) _hourTier.add(when, activity);
+    (void) _dayTier.add(when, activity);
+    now = _minuteTier.slot(offset);
+  }
+  if (counted)
+  {
+    markChanged(offset);
+  }
+  Log.info("minutes[%d] is now %lu", offset, now);
+}
+
+void
+ActivityDigest::markChanged(const unsigned int slot)
+{
+  _changed[slot / 32].fetch_or(1UL << (slot % 32));
+}
+
+const unsigned int
+ActivityDigest::unplaced() const
+{
+  return _unplacedTotal;
+}
+
+void
+ActivityDigest::place(const time_t shift)
+{
+  Log.info("placing %u activities from before the rtc was set", _unplacedTotal);
+  for (int minute = 0; minute < DIGEST_UNPLACED_MINUTES; minute++)
+  {
+    if (_unplaced[minute])
+    {
+      // the unset rtc's minutes straddle minutes of the day; go by the middle of each
+      count(shift + minute * 60 + 30, _unplaced[minute]);
+    }
+  }
+
+  memset(_unplaced, 0, sizeof(_unplaced));
+  _unplacedTotal = 0;
 }
 
 void
@@ -57,80 +176,234 @@ ActivityDigest::dump() const
   Log.info("Digest info:");
   for (int i = 0; i <= offset; i++ )
   {
-    Log.info("slot[%d] = %d", i, _minutes[i]);
+    Log.info("slot[%d] = %lu", i, _minuteTier.slot(i));
   }
 }
 
-const bool
+void
 ActivityDigest::publishBacklog(const unsigned int entries)
 {
-  // bulk publish of backlog
-  // offset:count,count,...count
-  // 4+1 5+1 5+1 ... 5+1
-  // 255 = 5 + N * 6; N = 250/6 = 41
-  // so 2 publishes of 30 items each is 1 hour of data; 48 seconds for 1 day
-  //
-  // individual backlog publish: each hour 2 publishes
-  // expose function to publish now
-  // expose function to set publish rate
-  static char publishBuf[128];
-
-  // wait for 10s to attach to cloud; should be configurable
-  if (!waitFor(Particle.connected, 10000))
-  {
-    Log.warn("bummer, can't connect to cloud right not, try again later");
+  // just the request: the button handler must not wait on the cloud
+  _requested = entries;
+}
+
+const bool
+ActivityDigest::publishing() const
+{
+  return (_state != idle) || _requested.load();
+}
+
+const bool
+ActivityDigest::takeToken()
+{
+  uint32_t now = millis();
+  uint32_t earned = (now - _tokensAt) / DIGEST_PUBLISH_PERIOD;
+
+  if (earned)
+  {
+    _tokens = (_tokens + earned < DIGEST_PUBLISH_BURST) ? _tokens + earned : DIGEST_PUBLISH_BURST;
+    _tokensAt += earned * DIGEST_PUBLISH_PERIOD;
+  }
+  if (!_tokens)
+  {
     return false;
   }
-
-  // must disable sleep timer during this backlog update - fix
-  unsigned int initialActive;
-  ATOMIC_BLOCK()
+  if (_tokens == DIGEST_PUBLISH_BURST)
   {
-    initialActive = _active;
+    // a full bucket earns nothing more; the period starts over from the publish
+    _tokensAt = now;
   }
+  _tokens--;
 
-  unsigned int initialLastUploaded = _lastUploaded;
-  byte messageLength = 0;
-  for (unsigned int i = 0; i < entries; i++)
-  {
-    uint16_t minuteSummary;
-    unsigned int timeOffset = (initialLastUploaded + 1 + i) % _capacity;
-    minuteSummary = _minutes[timeOffset];
+  return true;
+}
 
-    if (messageLength == 0)
-    {
-      memset(publishBuf, 0, sizeof(publishBuf));
-      messageLength += sprintf(publishBuf, "%d:%d", timeOffset, minuteSummary);
-    }
-    else
-    {
-      messageLength += sprintf(&publishBuf[messageLength], ",%d", minuteSummary);
-    }
-    Log.info("using index %d, messageLength = %d", timeOffset, messageLength);
+const bool
+ActivityDigest::publish()
+{
+  // bulk publish of the changed minutes, a message a call, packed as DigestFormat describes: a day with the nights
+  // and idle stretches run-length encoded comes to a handful of messages rather than the 50-odd of one
+  // "offset:count,..." a message, and minutes that have not changed since they went are not sent again
+  static uint8_t densePacked[DigestFormat::maxBytes(DIGEST_PUBLISH_BYTES)];
+  static uint8_t sparsePacked[DigestFormat::maxBytes(DIGEST_PUBLISH_BYTES)];
+  static char publishBuf[DIGEST_PUBLISH_BYTES + 1];
 
-    if ((messageLength > (sizeof(publishBuf) - 6 - 1)) // buffer - (max size of printed uint16_t) - (leave space for NULL terminator)
-	|| (i + 1 >= entries))
-    {
-      Log.info("going to publish '%s'", publishBuf);
-      if (!Particle.connected() || (Particle.publish("activity", publishBuf) == false))
+  switch (_state)
+  {
+    case idle:
+      _publishLeft = _requested.exchange(0);
+      if (!_publishLeft)
       {
-	Log.info("publish failed; leaving backlog, last minute uploaded was %d", _lastUploaded);
 	return false;
       }
-      // particle.io mqtt throttles at 1/sec
-      delay(1000);
-      _lastUploaded = timeOffset;
-      messageLength = 0;
+      _publishStarted = millis();
+      _state = awaitingCloud;
+      // fall through
+
+    case awaitingCloud:
+      if (!Particle.connected())
+      {
+	if (millis() - _publishStarted > DIGEST_CONNECT_TIMEOUT)
+	{
+	  Log.warn("bummer, can't connect to cloud right not, try again later");
+	  _state = idle;
+	}
+	return publishing();
+      }
+      _state = sending;
+      // fall through
+
+    case sending:
+      break;
+  }
+
+  if (!takeToken())
+  {
+    return true;
+  }
+
+  // the changed minutes are taken all at once: activity counted while the message is built marks its minute again,
+  // and whatever the message does not cover is put back
+  static uint32_t taken[sizeof(_changed) / sizeof(_changed[0])];
+  const unsigned int words = sizeof(taken) / sizeof(taken[0]);
+  for (unsigned int w = 0; w < words; w++)
+  {
+    taken[w] = _changed[w].exchange(0);
+  }
+
+  // the oldest changed minute, going round from the oldest the ring holds
+  unsigned int newest = _minuteTier.newest() % _capacity;
+  unsigned int first = _capacity;
+  for (unsigned int i = 1; (first == _capacity) && (_minuteTier.newest() >= 0) && (i <= _capacity); i++)
+  {
+    unsigned int slot = (newest + i) % _capacity;
+    first = (taken[slot / 32] & (1UL << (slot % 32))) ? slot : first;
+  }
+  if (first == _capacity)
+  {
+    Log.info("no changed minutes left to publish");
+    _publishLeft = 0;
+    _state = idle;
+    return publishing();
+  }
+
+  // the same minutes both ways, each for as long as it fits: the sparse message wins if it covers more of the
+  // changed minutes, or as many in fewer bytes.  it does while activity is scattered; through a busy stretch the
+  // dense one's single token a minute is the smaller
+  DigestEncoder dense, sparse;
+  bool denseOpen = true;
+  bool sparseOpen = true;
+  unsigned int span = (newest + _capacity - first) % _capacity + 1;
+
+  dense.begin(densePacked, sizeof(densePacked), first);
+  sparse.begin(sparsePacked, sizeof(sparsePacked), first, true);
+  for (unsigned int i = 0; (i < span) && (denseOpen || sparseOpen); i++)
+  {
+    unsigned int slot = (first + i) % _capacity;
+    bool changed = taken[slot / 32] & (1UL << (slot % 32));
+    uint32_t activity = _minuteTier.slot(slot);
+    activity = (activity < 0xFFFF) ? activity : 0xFFFF;
+
+    denseOpen = denseOpen && (dense.changed() < _publishLeft) && dense.add(activity, changed);
+    sparseOpen = sparseOpen && (sparse.changed() < _publishLeft) && sparse.add(activity, changed);
+  }
+  size_t denseLength = dense.finish();
+  size_t sparseLength = sparse.finish();
+  bool useSparse = (sparse.changed() > dense.changed()) || ((sparse.changed() == dense.changed()) && (sparseLength <= denseLength));
+  DigestEncoder &encoder = useSparse ? sparse : dense;
+  (void) DigestFormat::toBase64(publishBuf, useSparse ? sparsePacked : densePacked, useSparse ? sparseLength : denseLength);
+
+  unsigned int minutes = encoder.minutes();
+  Log.info("going to publish %u minutes from %u, %u changed, %s as '%s'", minutes, first, encoder.changed(), useSparse ? "sparse" : "dense", publishBuf);
+  if (!Particle.connected() || (Particle.publish("activity", publishBuf) == false))
+  {
+    Log.info("publish failed; leaving %u changed minutes", encoder.changed());
+    minutes = 0;
+    _state = idle;
+  }
+  else
+  {
+    _publishLeft -= (encoder.changed() < _publishLeft) ? encoder.changed() : _publishLeft;
+  }
+
+  for (unsigned int i = 0; i < minutes; i++)
+  {
+    unsigned int slot = (first + i) % _capacity;
+    taken[slot / 32] &= ~(1UL << (slot % 32));
+  }
+  for (unsigned int w = 0; w < words; w++)
+  {
+    if (taken[w])
+    {
+      _changed[w].fetch_or(taken[w]);
     }
   }
+  if (!_publishLeft || !entries())
+  {
+    _state = idle;
+  }
 
-  return true;
+  return publishing();
+}
+
+// the part of [from, to) that 'tier' holds, back to where the next coarser tier (of buckets 'coarser' seconds long,
+// 0 for none) takes over on one of its bucket boundaries, so no bucket is counted twice; 'to' comes back as where
+// the tier left off
+template <typename Tier>
+static const uint32_t
+answer(const Tier &tier, const time_t from, time_t &to, const uint32_t coarser)
+{
+  if (tier.newest() < 0)
+  {
+    return 0;
+  }
+
+  time_t oldest = (time_t) tier.oldest() * tier.span();
+  if (coarser)
+  {
+    oldest = (oldest + coarser - 1) / coarser * coarser;
+  }
+  time_t start = (from > oldest) ? from : oldest;
+  if (start >= to)
+  {
+    return 0;
+  }
+
+  uint32_t sum = tier.sum(tier.bucket(start), tier.bucket(to - 1) + 1);
+  to = start;
+
+  return sum;
+}
+
+const uint32_t
+ActivityDigest::activity(const time_t from, const time_t to) const
+{
+  time_t end = to;
+  uint32_t sum = 0;
+
+  // the tiers and their indexes are moved on together by count() on the motion worker; a read halfway through that
+  // would take one tier's buckets at another's time, or a Fenwick node without the count it is summed from
+  ATOMIC_BLOCK()
+  {
+    sum += answer(_minuteTier, from, end, _hourTier.span());
+    sum += answer(_hourTier, from, end, _dayTier.span());
+    sum += answer(_dayTier, from, end, 0);
+  }
+
+  return sum;
 }
 
 const unsigned int
 ActivityDigest::entries() const
 {
-  return ((_active - _lastUploaded) + _capacity) % _capacity;
+  unsigned int changed = 0;
+
+  for (unsigned int w = 0; w < sizeof(_changed) / sizeof(_changed[0]); w++)
+  {
+    changed += __builtin_popcount(_changed[w].load());
+  }
+
+  return changed;
 }
 
 const unsigned int
@@ -7,9 +7,46 @@
 
 #pragma once
 
+#include <atomic>
 #include "application.h"
+#include "DigestFormat.h"
+#include "DigestTier.h"
 #include "MotionEntry.h"
 
+// minutes of activity kept aside while the rtc is unset, until they can be placed in the digest: the first this many
+// minutes the unset rtc counts from power-up
+#ifndef DIGEST_UNPLACED_MINUTES
+#define DIGEST_UNPLACED_MINUTES 240
+#endif
+
+// history kept beside the last day's minutes: hourly totals for this many days, daily totals for this many
+#ifndef DIGEST_HOUR_DAYS
+#define DIGEST_HOUR_DAYS 7
+#endif
+
+#ifndef DIGEST_DAYS
+#define DIGEST_DAYS 31
+#endif
+
+// publishing is rate limited by a token bucket: a burst of this many, then one every period, as the cloud allows
+#ifndef DIGEST_PUBLISH_BURST
+#define DIGEST_PUBLISH_BURST 4
+#endif
+
+#ifndef DIGEST_PUBLISH_PERIOD
+#define DIGEST_PUBLISH_PERIOD 1000
+#endif
+
+// publish data limit: 255 bytes on the device os this runs on (later ones take 622)
+#ifndef DIGEST_PUBLISH_BYTES
+#define DIGEST_PUBLISH_BYTES 255
+#endif
+
+// how long a requested publish waits for the cloud before giving up
+#ifndef DIGEST_CONNECT_TIMEOUT
+#define DIGEST_CONNECT_TIMEOUT 10000
+#endif
+
 class ActivityDigest
 {
   typedef struct ActiveMinute
@@ -23,7 +60,22 @@ public:
   virtual ~ActivityDigest ();
 
   void registerActivity(const MotionEntry &);
-  const bool publishBacklog(const unsigned int entries);
+  // activity stamped on the unset rtc, and moving it into the digest once the rtc is set (shift is what setting it
+  // added, see MotionClock::unsetToEpoch)
+  const unsigned int unplaced() const;
+  void place(const time_t shift);
+  // asks for up to 'entries' of the minutes changed since they were last published to be published, oldest first;
+  // safe from the button handler.  publish() does the work from loop(), at most one publish a call and only when the
+  // rate limit allows, so it never holds up the ring's uploads.  true while a publish is under way
+  void publishBacklog(const unsigned int entries);
+  const bool publish();
+  const bool publishing() const;
+  // activity in [from, to), epoch seconds, each part of it from the finest tier that holds it: minutes for the
+  // last day, hours for the last DIGEST_HOUR_DAYS days, days for the last DIGEST_DAYS.  the ends are rounded out to
+  // the buckets of the tier that answers for them; anything older than all of them counts nothing.  safe from any
+  // thread
+  const uint32_t activity(const time_t from, const time_t to) const;
+  // minutes changed and not yet published
   const unsigned int entries() const;
   const unsigned int capacity() const;
   const unsigned int remaining() const;
@@ -31,11 +83,41 @@ public:
 
 protected:
   const int timeOffset() const;
-  static retained int _active;
-  static retained int _lastUploaded;
+  const int timeOffset(const time_t when) const;
+  void count(const time_t when, const uint16_t activity);
+  void markChanged(const unsigned int slot);
+  const bool takeToken();
+
+  enum state
+  {
+    idle = 0,
+    awaitingCloud,
+    sending
+  };
   static retained time_t _lastActivity;
 //  static retained ActiveMinute _minutes[60*24];
-  static retained uint16_t _minutes[60*24];
+  // the tiers, by epoch minute, hour and day, a LogCount byte a bucket; a minute's slot is still its minute of the day
+  static retained uint8_t _minutes[60*24];
+  static retained uint8_t _hours[DIGEST_HOUR_DAYS * 24];
+  static retained uint8_t _days[DIGEST_DAYS];
+  static retained DigestHead _minuteHead;
+  static retained DigestHead _hourHead;
+  static retained DigestHead _dayHead;
+  DigestTier<60*24> _minuteTier;
+  DigestTier<DIGEST_HOUR_DAYS * 24> _hourTier;
+  DigestTier<DIGEST_DAYS> _dayTier;
+  // a bit a minute's slot, set when activity is counted into it and cleared once it is published
+  static retained std::atomic<uint32_t> _changed[60*24 / 32];
   const unsigned int _capacity;
   const unsigned int _hunkSize;
+  uint16_t _unplaced[DIGEST_UNPLACED_MINUTES];
+  unsigned int _unplacedTotal;
+
+  // the publish under way: the changed minutes left of it
+  std::atomic<unsigned int> _requested;
+  state _state;
+  unsigned int _publishLeft;
+  uint32_t _publishStarted;
+  uint8_t _tokens;
+  uint32_t _tokensAt;
 };
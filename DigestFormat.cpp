@@ -0,0 +1,267 @@
+/*
+ * DigestFormat.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <string.h>
+#include "DigestFormat.h"
+#include "WireFormat.h"
+
+static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const size_t
+DigestFormat::toBase64(char *out, const uint8_t *in, const size_t length)
+{
+  size_t size = 0;
+
+  for (size_t i = 0; i < length; i += 3)
+  {
+    uint32_t group = (uint32_t) in[i] << 16;
+    group |= (i + 1 < length) ? (uint32_t) in[i + 1] << 8 : 0;
+    group |= (i + 2 < length) ? in[i + 2] : 0;
+
+    // 2, 3 or 4 characters for 1, 2 or 3 bytes
+    size_t chars = (length - i < 3) ? length - i + 1 : 4;
+    for (size_t c = 0; c < chars; c++)
+    {
+      out[size++] = alphabet[(group >> (18 - 6 * c)) & 0x3F];
+    }
+  }
+  out[size] = '\0';
+
+  return size;
+}
+
+const int
+DigestFormat::fromBase64(uint8_t *out, const size_t size, const char *in, const size_t length)
+{
+  uint32_t group = 0;
+  unsigned int bits = 0;
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < length; i++)
+  {
+    const char *at = (in[i] != '\0') ? strchr(alphabet, in[i]) : NULL;
+    if (!at)
+    {
+      return -1;
+    }
+    group = (group << 6) | (at - alphabet);
+    bits += 6;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      if (bytes == size)
+      {
+	return -1;
+      }
+      out[bytes++] = (group >> bits) & 0xFF;
+    }
+  }
+
+  return bytes;
+}
+
+const int
+DigestFormat::decode(const uint8_t *in, const size_t length, uint16_t &first, uint16_t *counts, bool *given)
+{
+  if ((length < headerSize + crcSize) || ((in[0] != dense) && (in[0] != sparse)))
+  {
+    return -1;
+  }
+
+  uint32_t crc = (uint32_t) in[length - 4] | ((uint32_t) in[length - 3] << 8) | ((uint32_t) in[length - 2] << 16) | ((uint32_t) in[length - 1] << 24);
+  if (WireFormat::crc32(in, length - crcSize) != crc)
+  {
+    return -1;
+  }
+
+  first = in[1] | (in[2] << 8);
+  unsigned int minutes = in[3] | (in[4] << 8);
+  if ((first >= minutesPerDay) || (minutes > minutesPerDay))
+  {
+    return -1;
+  }
+
+  memset(given, in[0] == dense, minutes * sizeof(bool));
+  memset(counts, 0, minutes * sizeof(uint16_t));
+
+  unsigned int minute = 0;
+  size_t at = headerSize;
+  while ((at < length - crcSize) && (minute < minutes))
+  {
+    uint32_t token;
+    size_t used = WireFormat::getVarint(&in[at], length - crcSize - at, token);
+    if (!used)
+    {
+      return -1;
+    }
+    at += used;
+
+    if (in[0] == sparse)
+    {
+      // the gap, then the count of the minute after it
+      uint32_t count;
+      used = WireFormat::getVarint(&in[at], length - crcSize - at, count);
+      if (!used || (token >= minutes - minute) || (count > 0xFFFF))
+      {
+	return -1;
+      }
+      at += used;
+      minute += token;
+      given[minute] = true;
+      counts[minute++] = count;
+      continue;
+    }
+
+    uint32_t run = (token & 1) ? token >> 1 : 1;
+    uint32_t count = (token & 1) ? 0 : token >> 1;
+    if (!run || (run > minutes - minute) || (count > 0xFFFF))
+    {
+      return -1;
+    }
+    while (run--)
+    {
+      counts[minute++] = count;
+    }
+  }
+
+  // every minute accounted for (a sparse message's last ones may be unchanged), and nothing after them
+  return (((minute == minutes) || (in[0] == sparse)) && (at == length - crcSize)) ? (int) minutes : -1;
+}
+
+DigestEncoder::DigestEncoder ()
+ : _out(NULL)
+ , _capacity(0)
+ , _length(0)
+ , _sparse(false)
+ , _minutes(0)
+ , _changed(0)
+ , _run(0)
+{
+}
+
+void
+DigestEncoder::begin(uint8_t *out, const size_t capacity, const uint16_t first, const bool sparse)
+{
+  _out = out;
+  _capacity = capacity;
+  _sparse = sparse;
+  _out[0] = sparse ? DigestFormat::sparse : DigestFormat::dense;
+  _out[1] = first & 0xFF;
+  _out[2] = first >> 8;
+  _length = DigestFormat::headerSize;
+  _minutes = 0;
+  _changed = 0;
+  _run = 0;
+}
+
+const bool
+DigestEncoder::add(const uint16_t count, const bool changed)
+{
+  if (_minutes == DigestFormat::minutesPerDay)
+  {
+    return false;
+  }
+  if (_sparse)
+  {
+    // an unchanged minute only lengthens the gap; a changed one is the gap and its count
+    if (changed)
+    {
+      if (_length + varintSize(_run) + varintSize(count) + DigestFormat::crcSize > _capacity)
+      {
+	return false;
+      }
+      put(_run);
+      put(count);
+      _run = 0;
+      _changed++;
+    }
+    else
+    {
+      _run++;
+    }
+    _minutes++;
+    return true;
+  }
+
+  // the run in progress is written once it ends, but must always fit as it stands
+  size_t pending = _run ? varintSize(((uint32_t) _run << 1) | 1) : 0;
+  size_t needed = count ? pending + varintSize((uint32_t) count << 1) : varintSize(((uint32_t) (_run + 1) << 1) | 1);
+
+  if (_length + needed + DigestFormat::crcSize > _capacity)
+  {
+    return false;
+  }
+
+  _minutes++;
+  _changed += changed;
+  if (!count)
+  {
+    _run++;
+    return true;
+  }
+  if (_run)
+  {
+    put(((uint32_t) _run << 1) | 1);
+    _run = 0;
+  }
+  put((uint32_t) count << 1);
+
+  return true;
+}
+
+const size_t
+DigestEncoder::finish()
+{
+  // a sparse message has nothing to say about the unchanged minutes at its end
+  if (_run && !_sparse)
+  {
+    put(((uint32_t) _run << 1) | 1);
+    _run = 0;
+  }
+  _out[3] = _minutes & 0xFF;
+  _out[4] = _minutes >> 8;
+
+  uint32_t crc = WireFormat::crc32(_out, _length);
+  for (int i = 0; i < 4; i++)
+  {
+    _out[_length++] = (crc >> (8 * i)) & 0xFF;
+  }
+
+  return _length;
+}
+
+const uint16_t
+DigestEncoder::minutes() const
+{
+  return _minutes;
+}
+
+const uint16_t
+DigestEncoder::changed() const
+{
+  return _changed;
+}
+
+const size_t
+DigestEncoder::varintSize(uint32_t value)
+{
+  size_t size = 1;
+
+  while (value >= 0x80)
+  {
+    value >>= 7;
+    size++;
+  }
+
+  return size;
+}
+
+void
+DigestEncoder::put(const uint32_t token)
+{
+  _length += WireFormat::putVarint(&_out[_length], token);
+}
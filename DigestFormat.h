@@ -0,0 +1,74 @@
+/*
+ * DigestFormat.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// compact encoding of activity digest publishes; kept free of particle headers so host tools can share it
+//
+// a publish is the base64 (rfc 4648 alphabet, unpadded) of (little-endian):
+//   version, first minute of the day (uint16), minutes covered (uint16), tokens, crc-32 of everything before it
+// a dense message (version 1) gives every minute it covers: each token is a varint, count << 1 for one minute's
+// activity or (run << 1) | 1 for a run of minutes with none, which is what most of a day (and all of a night) is.
+// a sparse one (version 2) gives only the minutes that changed since they were last sent, each as a pair of varints:
+// the minutes since the previous one given (or since the first minute), then its count.  the others are as they
+// were.  minutes run on past midnight back to minute 0
+class DigestFormat
+{
+public:
+  enum
+  {
+    dense = 1,
+    sparse = 2
+  };
+
+  static const size_t headerSize = 5;
+  static const size_t crcSize = 4;
+  static const unsigned int minutesPerDay = 60 * 24;
+
+  // the binary bytes a message of 'chars' base64 characters carries
+  static constexpr size_t maxBytes(const size_t chars) { return chars / 4 * 3 + ((chars % 4) ? chars % 4 - 1 : 0); }
+  // 'out' gets the characters and a terminating nul, 4 for every 3 bytes rounded up, plus 1
+  static const size_t toBase64(char *out, const uint8_t *in, const size_t length);
+  // bytes decoded, or -1 on a character outside the alphabet or more than 'size' bytes
+  static const int fromBase64(uint8_t *out, const size_t size, const char *in, const size_t length);
+
+  // a message's minutes into 'counts' and whether it gave each into 'given' (at least minutesPerDay of each): how
+  // many minutes it covered, or -1 if it is damaged, of another version or covers more than a day
+  static const int decode(const uint8_t *in, const size_t length, uint16_t &first, uint16_t *counts, bool *given);
+};
+
+// builds a message a minute at a time, for as many minutes as fit
+class DigestEncoder
+{
+public:
+  DigestEncoder ();
+
+  void begin(uint8_t *out, const size_t capacity, const uint16_t first, const bool sparse = false);
+  // the next minute, and whether it changed (a sparse message leaves out those that did not); false when it does
+  // not fit, and the message is complete without it
+  const bool add(const uint16_t count, const bool changed = true);
+  // closes the message; its length in bytes
+  const size_t finish();
+  const uint16_t minutes() const;
+  // the changed minutes among them
+  const uint16_t changed() const;
+
+protected:
+  static const size_t varintSize(uint32_t value);
+  void put(const uint32_t token);
+
+  uint8_t *_out;
+  size_t _capacity;
+  size_t _length;
+  bool _sparse;
+  uint16_t _minutes;
+  uint16_t _changed;
+  uint16_t _run;	// minutes without activity (dense) or unchanged (sparse) not yet written
+};
@@ -0,0 +1,182 @@
+/*
+ * DigestTier.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "FenwickTree.h"
+#include "LogCount.h"
+
+// where a tier's ring has got to: the newest bucket (-1 while nothing has been counted) and its count so far, kept
+// exact until the ring moves on and it is rounded into its LogCount code
+typedef struct DigestHead
+{
+  int32_t _newest;
+  uint32_t _open;
+} DigestHead;
+
+// one resolution of the activity digest: a ring of N buckets of 'span' seconds, numbered by epoch seconds / span,
+// holding the N buckets up to the newest one counted in.  buckets are cleared as time moves on past them, so a day
+// never adds onto the day before.  the codes and the head are the caller's (retained) storage, a byte a bucket; a
+// Fenwick tree over the decoded counts answers range sums in O(log N)
+template <uint32_t N>
+class DigestTier
+{
+public:
+  DigestTier (uint8_t *codes, DigestHead &head, const uint32_t span)
+  : _codes(codes)
+  , _head(head)
+  , _span(span)
+  {
+  }
+
+  // after a cold boot nothing has been counted and the codes are garbage; after a wake they are intact and only the
+  // index needs rebuilding
+  void begin()
+  {
+    if (_head._newest < 0)
+    {
+      memset(_codes, 0, N);
+      _head._open = 0;
+    }
+    _sums.build([this](const uint32_t index) { return slot(index); });
+  }
+
+  const uint32_t span() const
+  {
+    return _span;
+  }
+
+  const int32_t bucket(const time_t when) const
+  {
+    return when / _span;
+  }
+
+  const int32_t newest() const
+  {
+    return _head._newest;
+  }
+
+  const int32_t oldest() const
+  {
+    return _head._newest - (int32_t) N + 1;
+  }
+
+  const bool holds(const int32_t bucket) const
+  {
+    return (_head._newest >= 0) && (bucket <= _head._newest) && (bucket >= oldest());
+  }
+
+  // what was counted: none when the bucket is older than the ring holds.  the newest bucket counts exactly; an
+  // older one (activity placed late) takes the count rounded into its code, see LogCount::increment()
+  const uint32_t add(const time_t when, const uint32_t count)
+  {
+    int32_t at = bucket(when);
+
+    advance(at);
+    if (!holds(at))
+    {
+      return 0;
+    }
+
+    uint32_t index = at % N;
+    if (at == _head._newest)
+    {
+      uint32_t added = (count < LogCount::maximum - _head._open) ? count : LogCount::maximum - _head._open;
+      _head._open += added;
+      _sums.add(index, added);
+      return added;
+    }
+
+    uint32_t before = LogCount::decode(_codes[index]);
+    _codes[index] = LogCount::increment(_codes[index], count);
+    _sums.add(index, (int32_t) LogCount::decode(_codes[index]) - (int32_t) before);
+
+    return count;
+  }
+
+  const uint32_t count(const int32_t bucket) const
+  {
+    if (!holds(bucket))
+    {
+      return 0;
+    }
+
+    return (bucket == _head._newest) ? _head._open : LogCount::decode(_codes[bucket % N]);
+  }
+
+  // by place in the ring, for callers that go by it (a minute's place is its minute of the day)
+  const uint32_t slot(const uint32_t index) const
+  {
+    return ((_head._newest >= 0) && (index == _head._newest % N)) ? _head._open : LogCount::decode(_codes[index]);
+  }
+
+  // buckets [from, to), as much of them as the ring holds
+  const uint32_t sum(int32_t from, int32_t to) const
+  {
+    if (_head._newest < 0)
+    {
+      return 0;
+    }
+    from = (from > oldest()) ? from : oldest();
+    to = (to <= _head._newest) ? to : _head._newest + 1;
+    if (from >= to)
+    {
+      return 0;
+    }
+    if (to - from == (int32_t) N)
+    {
+      return _sums.prefix(N);
+    }
+
+    uint32_t first = from % N;
+    uint32_t last = to % N;
+    return (first < last) ? _sums.range(first, last) : _sums.range(first, N) + _sums.prefix(last);
+  }
+
+  // moves the ring on to 'bucket': the newest bucket is rounded into its code and the buckets passed are cleared;
+  // a bucket is only reused a whole ring later.  add() does this itself; a caller moving a long way on can go a
+  // stretch at a time
+  void advance(const int32_t bucket)
+  {
+    if (_head._newest < 0)
+    {
+      _head._newest = bucket;
+      _head._open = 0;
+      return;
+    }
+    if (bucket <= _head._newest)
+    {
+      return;
+    }
+
+    uint32_t index = _head._newest % N;
+    _codes[index] = LogCount::encode(_head._open);
+    _sums.add(index, (int32_t) LogCount::decode(_codes[index]) - (int32_t) _head._open);
+
+    uint32_t passed = ((uint32_t) (bucket - _head._newest) < N) ? bucket - _head._newest : N;
+    for (uint32_t i = 1; i <= passed; i++)
+    {
+      index = (_head._newest + i) % N;
+      if (_codes[index])
+      {
+	_sums.add(index, -(int32_t) LogCount::decode(_codes[index]));
+	_codes[index] = 0;
+      }
+    }
+    _head._newest = bucket;
+    _head._open = 0;
+  }
+
+protected:
+  uint8_t *_codes;
+  DigestHead &_head;
+  const uint32_t _span;
+  FenwickTree<N> _sums;
+};
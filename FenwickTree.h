@@ -0,0 +1,79 @@
+/*
+ * FenwickTree.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// binary indexed tree of N sums: point updates and prefix sums in O(log N), built from the values in O(N).
+// the counts themselves live elsewhere (retained, see ActivityDigest); this is the index over them, kept in ordinary
+// ram and rebuilt after a wake
+template <uint32_t N>
+class FenwickTree
+{
+public:
+  FenwickTree ()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    for (uint32_t i = 0; i <= N; i++)
+    {
+      _tree[i] = 0;
+    }
+  }
+
+  // 'value' gives the value at each index
+  template <typename F> void build(const F &value)
+  {
+    for (uint32_t i = 1; i <= N; i++)
+    {
+      _tree[i] = value(i - 1);
+    }
+    // each node passes its sum up to its parent
+    for (uint32_t i = 1; i <= N; i++)
+    {
+      uint32_t parent = i + (i & -i);
+      if (parent <= N)
+      {
+	_tree[parent] += _tree[i];
+      }
+    }
+  }
+
+  void add(const uint32_t index, const int32_t delta)
+  {
+    for (uint32_t i = index + 1; i <= N; i += i & -i)
+    {
+      _tree[i] += delta;
+    }
+  }
+
+  // sum of [0, end)
+  const uint32_t prefix(const uint32_t end) const
+  {
+    uint32_t sum = 0;
+
+    for (uint32_t i = (end < N) ? end : N; i; i -= i & -i)
+    {
+      sum += _tree[i];
+    }
+
+    return sum;
+  }
+
+  // sum of [from, to)
+  const uint32_t range(const uint32_t from, const uint32_t to) const
+  {
+    return (from < to) ? prefix(to) - prefix(from) : 0;
+  }
+
+protected:
+  uint32_t _tree[N + 1];
+};
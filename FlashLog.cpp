@@ -0,0 +1,467 @@
+/*
+ * FlashLog.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <stddef.h>
+#include "FlashLog.h"
+
+FlashLog::FlashLog (SpiFlash &flash, const uint32_t start, const uint32_t sectors)
+ : _flash(flash)
+ , _start(start)
+ , _sectors(sectors)
+ , _ready(false)
+ , _head(0)
+ , _tail(0)
+ , _tailSector(0)
+ , _tailOpen(false)
+ , _sequence(0)
+ , _records(0)
+ , _entries(0)
+ , _readAddress(0)
+ , _readSkip(0)
+ , _readValid(false)
+ , _readOffset(0)
+ , _readIndex(0)
+ , _windowLength(0)
+{
+}
+
+FlashLog::~FlashLog ()
+{
+}
+
+const bool
+FlashLog::begin()
+{
+  SectorHeader header;
+  bool found = false;
+
+  _ready = false;
+  _records = 0;
+  _entries = 0;
+  if (_sectors < 2)
+  {
+    return false;
+  }
+
+  // the tail is the sector with the highest sequence
+  for (uint32_t sector = 0; sector < _sectors; sector++)
+  {
+    if (readSector(sector, header) && (!found || (header._sequence > _sequence)))
+    {
+      found = true;
+      _sequence = header._sequence;
+      _tailSector = sector;
+    }
+  }
+  if (!found)
+  {
+    // a blank region: the first sector opened is sector 0
+    _sequence = 0;
+    _tailSector = _sectors - 1;
+    closeSector();
+    _head = _tail;
+    _ready = true;
+    Log.info("flash log of %lu sectors is empty", _sectors);
+    return true;
+  }
+
+  // the log runs back from the tail for as long as the sequences count down
+  uint32_t oldest = _tailSector;
+  for (uint32_t back = 1; back < _sectors; back++)
+  {
+    uint32_t sector = (_tailSector + _sectors - back) % _sectors;
+    if (!readSector(sector, header) || (header._sequence != _sequence - back))
+    {
+      break;
+    }
+    oldest = sector;
+  }
+
+  // new records go in a fresh sector: the old tail may end in a torn write
+  closeSector();
+  _head = _tail;
+
+  // the head is the first record not yet consumed
+  for (uint32_t sector = oldest; ; sector = (sector + 1) % _sectors)
+  {
+    if (readSector(sector, header) && (header._consumed == 0xFF))
+    {
+      RecordHeader record;
+      for (uint32_t address = firstRecord(sector); readRecord(address, record); address += sizeof(record) + record._length)
+      {
+	if (record._consumed == 0xFF)
+	{
+	  _head = _records ? _head : address;
+	  _records++;
+	  _entries += record._entries;
+	}
+      }
+    }
+    if (sector == _tailSector)
+    {
+      break;
+    }
+  }
+
+  _ready = true;
+  Log.info("flash log holds %lu entries in %lu records", _entries, _records);
+
+  return true;
+}
+
+const bool
+FlashLog::ready() const
+{
+  return _ready;
+}
+
+const uint32_t
+FlashLog::records() const
+{
+  return _records;
+}
+
+const uint32_t
+FlashLog::entries() const
+{
+  return _entries;
+}
+
+const size_t
+FlashLog::maxRecord()
+{
+  return SpiFlash::sectorSize - sizeof(SectorHeader) - sizeof(RecordHeader);
+}
+
+const bool
+FlashLog::append(const uint8_t *frame, const uint16_t length, const uint16_t entries, const uint16_t epochFrom)
+{
+  if (!_ready || (length > maxRecord()))
+  {
+    return false;
+  }
+  if ((!_tailOpen || (_tail + sizeof(RecordHeader) + length > sectorAddress(_tailSector) + SpiFlash::sectorSize)) && !openSector())
+  {
+    return false;
+  }
+
+  RecordHeader header;
+  memset(&header, 0xFF, sizeof(header));
+  header._magic = recordMagic;
+  header._consumed = 0xFF;
+  header._length = length;
+  header._entries = entries;
+  header._epochFrom = epochFrom;
+  header._crc = WireFormat::crc32(&header._length, offsetof(RecordHeader, _crc) - offsetof(RecordHeader, _length));
+  header._crc = WireFormat::crc32(frame, length, header._crc);
+
+  // the header last, and its magic last of all: until that is down the record does not exist
+  const uint8_t *bytes = (const uint8_t *) &header;
+  if (!_flash.program(_tail + sizeof(header), frame, length) || !_flash.program(_tail + 1, &bytes[1], sizeof(header) - 1)
+      || !_flash.program(_tail, bytes, 1))
+  {
+    // whatever was written is unreadable; carry on in the next sector
+    closeSector();
+    return false;
+  }
+
+  _head = _records ? _head : _tail;
+  _tail += sizeof(header) + length;
+  _records++;
+  _entries += entries;
+
+  return true;
+}
+
+void
+FlashLog::consume(uint32_t records)
+{
+  while (records-- && _records)
+  {
+    RecordHeader header;
+    (void) readRecord(_head, header);
+    markConsumed(_head, offsetof(RecordHeader, _consumed));
+    _records--;
+    _entries -= header._entries;
+
+    uint32_t next = _records ? following(_head) : _tail;
+    if (sectorOf(next) != sectorOf(_head))
+    {
+      markConsumed(sectorAddress(sectorOf(_head)), offsetof(SectorHeader, _consumed));
+    }
+    _head = next;
+  }
+}
+
+const uint32_t
+FlashLog::date(const int64_t shift, const bool known)
+{
+  const uint8_t marked = 0;
+  uint32_t lost = 0;
+  uint32_t address = _head;
+
+  for (uint32_t i = 0; i < _records; i++, address = following(address))
+  {
+    RecordHeader header;
+    if (readRecord(address, header) && (header._epochFrom < header._entries) && !dated(header))
+    {
+      // programming only clears bits: over a torn shift only one with none of the bits it lost set will do
+      int64_t value = known ? shift : (int64_t) unplaceable;
+      value = ((header._shift & value) == value) ? value : (int64_t) unplaceable;
+      (void) _flash.program(address + offsetof(RecordHeader, _shift), (const uint8_t *) &value, sizeof(value));
+      (void) _flash.program(address + offsetof(RecordHeader, _dated), &marked, sizeof(marked));
+      lost += (value == unplaceable) ? header._entries - header._epochFrom : 0;
+    }
+  }
+
+  return lost;
+}
+
+const bool
+FlashLog::seek(const uint32_t skip)
+{
+  if (skip >= _records)
+  {
+    return false;
+  }
+
+  uint32_t address = _head;
+  for (uint32_t i = 0; i < skip; i++)
+  {
+    address = following(address);
+  }
+  _readSkip = skip;
+
+  return load(address);
+}
+
+const bool
+FlashLog::advance()
+{
+  if (_readSkip + 1 >= _records)
+  {
+    return false;
+  }
+  _readSkip++;
+
+  return load(following(_readAddress));
+}
+
+const uint16_t
+FlashLog::recordEntries() const
+{
+  if (!_readValid)
+  {
+    return 0;
+  }
+
+  // the placed entries come first
+  return (dated(_reading) && (_reading._shift == unplaceable)) ? _reading._epochFrom : _reading._entries;
+}
+
+const bool
+FlashLog::epochUnknown() const
+{
+  return _readValid && (_reading._epochFrom < _reading._entries) && !dated(_reading);
+}
+
+const bool
+FlashLog::next(MotionEntry &entry)
+{
+  while (_readValid && (_readIndex < recordEntries()))
+  {
+    // keep more than an entry's worth of the frame in the window
+    size_t more = _reading._length - _readOffset;
+    more = (more < sizeof(_window) - _windowLength) ? more : sizeof(_window) - _windowLength;
+    _flash.read(_readAddress + sizeof(RecordHeader) + _readOffset, &_window[_windowLength], more);
+    _readOffset += more;
+    _windowLength += more;
+
+    bool decoded;
+    int used = _decoder.next(_window, _windowLength, entry, decoded);
+    if (used <= 0)
+    {
+      // it passed its crc, so it was written that way
+      Log.error("undecodable record at %06lx in the flash log", _readAddress);
+      _readValid = false;
+      break;
+    }
+    memmove(_window, &_window[used], _windowLength - used);
+    _windowLength -= used;
+
+    if (decoded)
+    {
+      entry._epochUnknown = (_readIndex++ >= _reading._epochFrom);
+      if (entry._epochUnknown && dated(_reading))
+      {
+	WireFormat::setMicros(entry, WireFormat::micros(entry) + _reading._shift);
+	entry._epochUnknown = false;
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const uint32_t
+FlashLog::sectorAddress(const uint32_t sector) const
+{
+  return _start + sector * SpiFlash::sectorSize;
+}
+
+const uint32_t
+FlashLog::sectorOf(const uint32_t address) const
+{
+  return (address - _start) / SpiFlash::sectorSize;
+}
+
+const uint32_t
+FlashLog::firstRecord(const uint32_t sector) const
+{
+  return sectorAddress(sector) + sizeof(SectorHeader);
+}
+
+const bool
+FlashLog::readSector(const uint32_t sector, SectorHeader &header) const
+{
+  _flash.read(sectorAddress(sector), (uint8_t *) &header, sizeof(header));
+
+  return (header._magic == sectorMagic) && (header._check == ~header._sequence);
+}
+
+const bool
+FlashLog::readRecord(const uint32_t address, RecordHeader &header) const
+{
+  uint32_t end = sectorAddress(sectorOf(address)) + SpiFlash::sectorSize;
+
+  if (address + sizeof(header) > end)
+  {
+    return false;
+  }
+  _flash.read(address, (uint8_t *) &header, sizeof(header));
+
+  return (header._magic == recordMagic) && (address + sizeof(header) + header._length <= end);
+}
+
+const uint32_t
+FlashLog::following(const uint32_t address) const
+{
+  RecordHeader header;
+
+  // records never span sectors: past the last one in a sector comes the first of the next that has one.  a sector
+  // whose only record was torn by a reset has none
+  if (readRecord(address, header))
+  {
+    uint32_t next = address + sizeof(header) + header._length;
+    if ((next == _tail) || readRecord(next, header))
+    {
+      return next;
+    }
+  }
+
+  for (uint32_t sector = sectorOf(address), i = 1; i < _sectors; i++)
+  {
+    uint32_t first = firstRecord((sector + i) % _sectors);
+    if ((first == _tail) || readRecord(first, header))
+    {
+      return first;
+    }
+  }
+
+  return _tail;
+}
+
+const bool
+FlashLog::openSector()
+{
+  uint32_t sector = (_tailSector + 1) % _sectors;
+
+  if (_records && (sectorOf(_head) == sector))
+  {
+    return false;
+  }
+
+  // an emptied tail sector is left consumed, as the head would have left it
+  if (!_records && _tailOpen)
+  {
+    markConsumed(sectorAddress(_tailSector), offsetof(SectorHeader, _consumed));
+  }
+
+  SectorHeader header;
+  memset(&header, 0xFF, sizeof(header));
+  header._magic = sectorMagic;
+  header._sequence = _sequence + 1;
+  header._check = ~header._sequence;
+
+  _tailSector = sector;
+  _sequence++;
+  if (!_flash.eraseSector(sectorAddress(sector)) || !_flash.program(sectorAddress(sector), (const uint8_t *) &header, sizeof(header)))
+  {
+    closeSector();
+    return false;
+  }
+
+  _tail = firstRecord(sector);
+  _tailOpen = true;
+  _head = _records ? _head : _tail;
+
+  return true;
+}
+
+void
+FlashLog::closeSector()
+{
+  _tailOpen = false;
+  _tail = firstRecord((_tailSector + 1) % _sectors);
+}
+
+const bool
+FlashLog::dated(const RecordHeader &header)
+{
+  // the marker is programmed after the shift, so any of its bits cleared means the shift is whole
+  return header._dated != 0xFF;
+}
+
+void
+FlashLog::markConsumed(const uint32_t address, const size_t offset)
+{
+  uint8_t consumed = 0;
+
+  (void) _flash.program(address + offset, &consumed, 1);
+}
+
+const bool
+FlashLog::load(const uint32_t address)
+{
+  uint8_t chunk[64];
+
+  _readAddress = address;
+  _readOffset = 0;
+  _readIndex = 0;
+  _windowLength = 0;
+  _decoder.reset();
+
+  _readValid = readRecord(address, _reading);
+  if (_readValid)
+  {
+    uint32_t crc = WireFormat::crc32(&_reading._length, offsetof(RecordHeader, _crc) - offsetof(RecordHeader, _length));
+    for (uint16_t offset = 0; offset < _reading._length; offset += sizeof(chunk))
+    {
+      size_t length = ((size_t) (_reading._length - offset) < sizeof(chunk)) ? _reading._length - offset : sizeof(chunk);
+      _flash.read(address + sizeof(RecordHeader) + offset, chunk, length);
+      crc = WireFormat::crc32(chunk, length, crc);
+    }
+    _readValid = (crc == _reading._crc);
+  }
+  if (!_readValid)
+  {
+    Log.warn("record at %06lx in the flash log is damaged; skipping it", address);
+  }
+
+  return true;
+}
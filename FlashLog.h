@@ -0,0 +1,137 @@
+/*
+ * FlashLog.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include "application.h"
+#include "MotionEntry.h"
+#include "SpiFlash.h"
+#include "WireFormat.h"
+
+// the spill tier's share of the spi flash: FLASH_LOG_SECTORS 4 KB sectors from FLASH_LOG_START.  1024 is a 4 MB
+// W25Q32, an hour or so of continuous streaming at 10 bytes an entry
+#ifndef FLASH_LOG_START
+#define FLASH_LOG_START 0
+#endif
+
+#ifndef FLASH_LOG_SECTORS
+#define FLASH_LOG_SECTORS 1024
+#endif
+
+// a log of records in spi flash, for entries the ring has no room for.  records are appended at the tail and
+// consumed from the head; the sectors are used round robin, each erased only when the tail comes back around to it,
+// so wear is spread evenly across the region.
+//
+// every sector starts with a header carrying a sequence number, which is how begin() finds the tail after a reset.
+// each record is a WireFormat frame behind a header with its crc; the frame is programmed before the header, so a
+// record torn by power loss has no valid header and is never read.  once sent, a record's consumed byte is
+// programmed to 0, and a sector's once the head has left it.  after a reset the log carries on in a fresh sector,
+// never after whatever a torn write left in the old tail.
+//
+// entries stamped on the unset rtc only mean anything to a boot that saw it counting, so the shift onto the epoch is
+// programmed into their records (see date()) by the boot that learns it, and they read as placed from then on, after
+// any number of resets.  records no such boot ever dated read as their placed entries alone
+class FlashLog
+{
+public:
+  FlashLog (SpiFlash &flash, const uint32_t start = FLASH_LOG_START, const uint32_t sectors = FLASH_LOG_SECTORS);
+  virtual ~FlashLog ();
+
+  // finds the log earlier boots left; the flash must have begun
+  const bool begin();
+  const bool ready() const;
+  // live (unconsumed) records, and the entries in them
+  const uint32_t records() const;
+  const uint32_t entries() const;
+  static const size_t maxRecord();
+
+  // one record: a WireFormat frame of 'entries' entries, of which those from 'epochFrom' on are stamped on the unset
+  // rtc's count.  false if the log is full
+  const bool append(const uint8_t *frame, const uint16_t length, const uint16_t entries, const uint16_t epochFrom);
+  // marks the oldest records sent
+  void consume(uint32_t records);
+  // once the epoch is known: gives the live records with entries on the unset rtc's count the shift onto it, or, when
+  // this boot never saw the rtc unset ('known' false), marks them as never to be placed.  a shift torn by power loss
+  // is finished if this one can be programmed over it, and the record marked as never to be placed if not.  returns
+  // the entries lost
+  const uint32_t date(const int64_t shift, const bool known);
+
+  // reading, without consuming: seek() to the record 'skip' past the oldest, next() through its entries, advance()
+  // to the record after it.  a record that fails its crc reads as having no entries.  entries of a dated record come
+  // out placed on the epoch; epochUnknown() while the record has some that are not yet
+  const bool seek(const uint32_t skip);
+  const bool advance();
+  const uint16_t recordEntries() const;
+  const bool epochUnknown() const;
+  const bool next(MotionEntry &entry);
+
+protected:
+  enum
+  {
+    sectorMagic = 0x474F4C4D,	// "MLOG"
+    recordMagic = 0x5B,
+    unplaceable = 0	// _shift of entries no boot that saw them stamped can place
+  };
+
+  typedef struct SectorHeader
+  {
+    uint32_t _magic;
+    uint32_t _sequence;
+    uint32_t _check;	// ~_sequence, so a torn header is not taken for one
+    uint8_t _consumed;	// 0xFF while the sector holds records not yet sent
+    uint8_t _reserved[3];
+  } SectorHeader;
+
+  typedef struct RecordHeader
+  {
+    uint8_t _magic;
+    uint8_t _consumed;	// 0xFF until sent; outside the crc
+    uint16_t _length;	// of the frame that follows
+    uint16_t _entries;
+    uint16_t _epochFrom;
+    uint32_t _crc;	// over _length, _entries, _epochFrom and the frame
+    uint8_t _dated;	// 0xFF until _shift is programmed whole, so a shift torn by power loss is never applied
+    uint8_t _reserved[3];
+    int64_t _shift;	// onto the epoch for the entries from _epochFrom on; all ones until dated, outside the crc
+  } RecordHeader;
+
+  static const bool dated(const RecordHeader &header);
+
+  const uint32_t sectorAddress(const uint32_t sector) const;
+  const uint32_t sectorOf(const uint32_t address) const;
+  const uint32_t firstRecord(const uint32_t sector) const;
+  const bool readSector(const uint32_t sector, SectorHeader &header) const;
+  const bool readRecord(const uint32_t address, RecordHeader &header) const;
+  const uint32_t following(const uint32_t address) const;
+  const bool openSector();
+  void closeSector();
+  void markConsumed(const uint32_t address, const size_t offset);
+  const bool load(const uint32_t address);
+
+  SpiFlash &_flash;
+  const uint32_t _start;
+  const uint32_t _sectors;
+  bool _ready;
+  uint32_t _head;	// oldest live record; _tail when there are none
+  uint32_t _tail;	// where the next record goes; the next sector's first record while no sector is open
+  uint32_t _tailSector;
+  bool _tailOpen;
+  uint32_t _sequence;	// of the tail sector
+  uint32_t _records;
+  uint32_t _entries;
+
+  // the record being read
+  uint32_t _readAddress;
+  uint32_t _readSkip;
+  RecordHeader _reading;
+  bool _readValid;
+  uint16_t _readOffset;
+  uint16_t _readIndex;
+  WireDecoder _decoder;
+  uint8_t _window[2 * WireFormat::maxEntrySize];
+  size_t _windowLength;
+};
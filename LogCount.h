@@ -0,0 +1,66 @@
+/*
+ * LogCount.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// counts in a byte, float-like: codes below 32 are the count itself, above that the high nibble is an exponent and
+// the low one a mantissa, (16 + mantissa) << (exponent - 1).  a count is rounded to the nearest code, so anything
+// from 32 up is within 1/32 of itself; counts saturate at 'maximum' (507904).  kept free of particle headers so host
+// tools can check it
+class LogCount
+{
+public:
+  static const uint32_t exact = 32;
+  static const uint32_t maximum = 31UL << 14;
+
+  static const uint32_t decode(const uint8_t code)
+  {
+    return (code < exact) ? code : (uint32_t) (16 + (code & 0x0F)) << ((code >> 4) - 1);
+  }
+
+  static const uint8_t encode(uint32_t count)
+  {
+    if (count < exact)
+    {
+      return count;
+    }
+    if (count >= maximum)
+    {
+      return 0xFF;
+    }
+
+    // the shift that leaves 5 significant bits, then round off what it drops
+    uint32_t shift = 0;
+    while ((count >> shift) >= 32)
+    {
+      shift++;
+    }
+    uint32_t mantissa = (count + (1UL << (shift - 1))) >> shift;
+    if (mantissa == 32)
+    {
+      mantissa = 16;
+      shift++;
+    }
+
+    return ((shift + 1) << 4) | (mantissa - 16);
+  }
+
+  // 'count' more on top of a code: the sum rounded, as encode() rounds it
+  static const uint8_t increment(const uint8_t code, const uint32_t count)
+  {
+    uint32_t sum = decode(code) + count;
+
+    return encode((sum < maximum) ? sum : maximum);
+  }
+
+  static const uint8_t merge(const uint8_t a, const uint8_t b)
+  {
+    return increment(a, decode(b));
+  }
+};
@@ -0,0 +1,183 @@
+/*
+ * MotionClock.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include "MotionClock.h"
+#include "WireFormat.h"
+
+MotionClock::MotionClock ()
+ : _lastTicks(0)
+ , _ticks(0)
+ , _offset(0)
+ , _unsetOffset(0)
+ , _lastSecond(0)
+ , _lastRead(0)
+ , _started(false)
+ , _epochKnown(false)
+ , _anchored(false)
+ , _logEpoch(false)
+ , _logAnchor(false)
+{
+}
+
+const int64_t
+MotionClock::now()
+{
+  bool known;
+
+  return read(System.ticks(), known);
+}
+
+void
+MotionClock::stamp(MotionEntry &entry)
+{
+  stamp(entry, System.ticks());
+}
+
+void
+MotionClock::stamp(MotionEntry &entry, const uint32_t ticks)
+{
+  bool known;
+
+  WireFormat::setMicros(entry, read(ticks, known));
+  entry._epochUnknown = !known;
+}
+
+const bool
+MotionClock::toEpoch(MotionEntry &entry) const
+{
+  if (!entry._epochUnknown)
+  {
+    return true;
+  }
+  if (!_epochKnown || !_started)
+  {
+    return false;
+  }
+
+  WireFormat::setMicros(entry, WireFormat::micros(entry) + unsetToEpoch());
+  entry._epochUnknown = false;
+
+  return true;
+}
+
+const bool
+MotionClock::epochKnown() const
+{
+  return _epochKnown;
+}
+
+const bool
+MotionClock::unsetSeen() const
+{
+  return _started;
+}
+
+const int64_t
+MotionClock::unsetToEpoch() const
+{
+  int64_t shift;
+
+  ATOMIC_BLOCK()
+  {
+    shift = _offset - _unsetOffset;
+  }
+
+  return shift;
+}
+
+const bool
+MotionClock::anchored() const
+{
+  return _anchored;
+}
+
+const int64_t
+MotionClock::read(const uint32_t ticks, bool &epochKnown)
+{
+  uint64_t extended;
+  int64_t offset;
+  bool logEpoch, logAnchor;
+
+  // the worker and the streaming timer both read the clock
+  ATOMIC_BLOCK()
+  {
+    uint32_t current = System.ticks();
+
+    _ticks += (uint32_t) (current - _lastTicks);
+    _lastTicks = current;
+    discipline();
+    extended = _ticks - (uint32_t) (current - ticks);
+    offset = _offset;
+    epochKnown = _epochKnown;
+    logEpoch = _logEpoch;
+    logAnchor = _logAnchor;
+    _logEpoch = false;
+    _logAnchor = false;
+  }
+
+  if (logEpoch)
+  {
+    Log.info("rtc set; samples stamped before can be moved onto the epoch");
+  }
+  if (logAnchor)
+  {
+    Log.info("sample clock anchored to the rtc at %lu", (uint32_t) _lastSecond);
+  }
+
+  return offset + (int64_t) (extended / System.ticksPerMicrosecond());
+}
+
+void
+MotionClock::discipline()
+{
+  if (_anchored)
+  {
+    return;
+  }
+
+  time_t second = Time.now();
+  int64_t micros = (int64_t) (_ticks / System.ticksPerMicrosecond());
+  int64_t offset = (int64_t) second * 1000000 - micros;
+
+  if (!Time.isValid())
+  {
+    // keep to the unset rtc's count, to the second
+    if (!_started || (offset > _offset + 1000000) || (offset < _offset - 1000000))
+    {
+      _offset = offset;
+      _unsetOffset = offset;
+      _started = true;
+    }
+    _lastSecond = 0;
+    return;
+  }
+
+  if (!_epochKnown)
+  {
+    _offset = offset;
+    _epochKnown = true;
+    _logEpoch = true;
+  }
+  // the second only just began if the last read, shortly before, still saw the previous one.  the anchor can fall
+  // behind the offset in use (the read lags the tick, or the rtc was nudged back by less than a second since), and
+  // then the offset stays put rather than take timestamps backwards
+  else if (Particle.connected() && _lastSecond && (second == _lastSecond + 1)
+	   && (_ticks - _lastRead < 20000ULL * System.ticksPerMicrosecond()))
+  {
+    _offset = (offset > _offset) ? offset : _offset;
+    _anchored = true;
+    _logAnchor = true;
+  }
+  // until then the offset is good to the second; follow the rtc if it jumps
+  else if ((offset > _offset + 1000000) || (offset < _offset - 1000000))
+  {
+    _offset = offset;
+  }
+
+  _lastSecond = second;
+  _lastRead = _ticks;
+}
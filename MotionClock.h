@@ -0,0 +1,59 @@
+/*
+ * MotionClock.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include "application.h"
+#include "MotionEntry.h"
+
+// microsecond timestamps for samples: the System.ticks() cycle counter, extended to 64 bits, plus an offset to the
+// rtc.  the counter wraps every 35 s at 120 MHz, so the clock has to be read more often than that; the motion worker
+// reads it every MOTION_WORKER_PERIOD ms.
+//
+// until the rtc is set (a cold boot that has not reached the cloud yet) the epoch is unknown.  the unset rtc still
+// counts, from power-up and on through deep sleep, so entries are stamped on its count and flagged, to be moved onto
+// the epoch by toEpoch() once it is known: by whatever setting the rtc added to it, whichever boot stamped them.  a
+// boot that finds the rtc already set never sees that count, and cannot move anything (see FlashLog::date()).
+// the rtc only counts seconds, so the offset is first taken to the second.  once the cloud has set the rtc, the clock
+// watches for it to tick over and anchors there, to within the time between two reads.  the anchor only ever moves
+// the offset forward, and after it the offset is never moved again, so timestamps stay monotonic even when the cloud
+// later nudges the rtc.  before the anchor the clock follows the rtc when it jumps by more than a second, either way
+class MotionClock
+{
+public:
+  MotionClock ();
+
+  // microseconds since the epoch, or on the unset rtc's count while the epoch is unknown
+  const int64_t now();
+  // stamps an entry now, or at a System.ticks() value from the last 35 s
+  void stamp(MotionEntry &entry);
+  void stamp(MotionEntry &entry, const uint32_t ticks);
+  // moves an epoch-unknown entry onto the epoch; false while the epoch is still unknown, or if this boot cannot tell
+  const bool toEpoch(MotionEntry &entry) const;
+  const bool epochKnown() const;
+  // this boot saw the rtc unset, so unsetToEpoch() holds for what was stamped on its count
+  const bool unsetSeen() const;
+  // microseconds setting the rtc added to its count, once known
+  const int64_t unsetToEpoch() const;
+  const bool anchored() const;
+
+protected:
+  const int64_t read(const uint32_t ticks, bool &epochKnown);
+  void discipline();
+
+  uint32_t _lastTicks;
+  uint64_t _ticks;	// extended System.ticks() at _lastTicks
+  int64_t _offset;	// epoch (or unset rtc) microseconds at tick 0
+  int64_t _unsetOffset;	// the unset rtc's microseconds at tick 0
+  time_t _lastSecond;
+  uint64_t _lastRead;	// _ticks at the last read that saw _lastSecond
+  bool _started;	// the unset rtc has been read
+  volatile bool _epochKnown;
+  volatile bool _anchored;
+  bool _logEpoch;
+  bool _logAnchor;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
-#include "application.h"
+#include <stdint.h>
+#include <time.h>
 
 class MotionEntry
 {
@@ -11,20 +12,109 @@ public:
   , _x(0)
   , _y(0)
   , _z(0)
+  , _micros(0)
+  , _epochUnknown(false)
   {
   }
 
-  MotionEntry(const time_t &time, const char mode, const int16_t x, const int16_t y, const int16_t z)
+  MotionEntry(const time_t &time, const char mode, const int16_t x, const int16_t y, const int16_t z, const uint32_t micros = 0)
   : _time(time)
   , _mode(mode)
   , _x(x)
   , _y(y)
   , _z(z)
+  , _micros(micros)
+  , _epochUnknown(false)
   {
   }
 
   time_t _time;
   char _mode;
   int16_t _x,_y,_z;
+  uint32_t _micros;	// within _time's second, 0-999999
+  bool _epochUnknown;	// stamped on the unset rtc's count since power-up, not the epoch (see MotionClock::toEpoch)
 };
 
+
+// ring storage form of a MotionEntry: 10 bytes instead of 20.
+// the LIS331 reports 12-bit samples left-justified in 16 bits, so the low nibble of each axis carries nothing and
+// is dropped; the timestamp's seconds are stored as a delta from the base time of the ring block the entry lives in
+// (up to 24 days), its microseconds in the 5 bits above the delta and the low 15 of the extra word, with the
+// epoch-unknown flag in its top bit.  8 bytes would leave the delta 5 bits, and every entry more than half a minute
+// after its block's first would pad out the rest of the block.  aligned to 2, so the uint64_t is read a word at a
+// time, never with a single ldrd
+class __attribute__((packed, aligned(2))) PackedMotionEntry
+{
+public:
+  enum
+  {
+    deltaBits = 21,
+    maxDelta = (1UL << deltaBits) - 1,
+    microsLowBits = 15,
+    epochUnknownFlag = 1U << 15
+  };
+
+  enum packedMode
+  {
+    unknown = 0,
+    interrupt = 1,
+    stream = 2,
+    padding = 3	// filler to the end of a block when a delta does not fit
+  };
+
+  PackedMotionEntry()
+  : _bits(0)
+  , _extra(0)
+  {
+  }
+
+  PackedMotionEntry(const MotionEntry &entry, const uint32_t delta)
+  : _bits((uint64_t) (delta & maxDelta)
+	  | ((uint64_t) ((entry._micros >> microsLowBits) & 0x1F) << deltaBits)
+	  | ((uint64_t) pack(entry._mode) << 26)
+	  | ((uint64_t) ((uint16_t) entry._x >> 4) << 28)
+	  | ((uint64_t) ((uint16_t) entry._y >> 4) << 40)
+	  | ((uint64_t) ((uint16_t) entry._z >> 4) << 52))
+  , _extra((entry._micros & (epochUnknownFlag - 1)) | (entry._epochUnknown ? epochUnknownFlag : 0))
+  {
+  }
+
+  static const PackedMotionEntry pad()
+  {
+    PackedMotionEntry entry;
+    entry._bits = (uint64_t) padding << 26;
+    return entry;
+  }
+
+  const bool isPadding() const
+  {
+    return ((_bits >> 26) & 0x3) == padding;
+  }
+
+  const MotionEntry expand(const time_t base) const
+  {
+    uint32_t micros = ((uint32_t) ((_bits >> deltaBits) & 0x1F) << microsLowBits) | (_extra & (epochUnknownFlag - 1));
+    MotionEntry entry(base + (time_t) (_bits & maxDelta), unpack((_bits >> 26) & 0x3), axis(28), axis(40), axis(52), micros);
+    entry._epochUnknown = (_extra & epochUnknownFlag) != 0;
+    return entry;
+  }
+
+protected:
+  static const uint8_t pack(const char mode)
+  {
+    return (mode == 'i') ? interrupt : (mode == 's') ? stream : unknown;
+  }
+
+  static const char unpack(const uint8_t mode)
+  {
+    return (mode == interrupt) ? 'i' : (mode == stream) ? 's' : 'x';
+  }
+
+  const int16_t axis(const int shift) const
+  {
+    return (int16_t) (((_bits >> shift) & 0xFFF) << 4);
+  }
+
+  uint64_t _bits;
+  uint16_t _extra;
+};
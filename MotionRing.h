@@ -0,0 +1,99 @@
+/*
+ * MotionRing.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include "MotionEntry.h"
+#include "RingBuffer.h"
+
+// ring of PackedMotionEntry with a base time per block of slots; entries go in and come out as MotionEntry.
+// a block's base is the time of the first entry written into it.  when an entry's delta from the base does not fit
+// (or time ran backwards) the rest of the block is padded and the entry starts a fresh block
+template <uint32_t N, uint32_t B = 32>
+class MotionRing
+{
+  static_assert((B != 0) && ((B & (B - 1)) == 0) && (B <= N), "MotionRing block size must be a power of two no larger than the ring");
+
+public:
+  MotionRing ()
+  {
+  }
+
+  // producer side
+  const bool push(const MotionEntry &entry)
+  {
+    uint32_t tail = _ring.tail();
+
+    if (tail & _blockMask)
+    {
+      time_t base = _base[block(tail)];
+
+      if ((entry._time >= base) && ((uint32_t) (entry._time - base) <= PackedMotionEntry::maxDelta))
+      {
+	return _ring.push(PackedMotionEntry(entry, entry._time - base));
+      }
+
+      // start a new block, as long as there is room for the padding and the entry
+      uint32_t padding = B - (tail & _blockMask);
+      if (N - (tail - _ring.head()) < padding + B)
+      {
+	return false;
+      }
+      while (padding--)
+      {
+	_ring.push(PackedMotionEntry::pad());
+      }
+      tail = _ring.tail();
+    }
+
+    // the base is shared by the whole block, so the previous occupant of this block must be fully consumed
+    if (N - (tail - _ring.head()) < B)
+    {
+      return false;
+    }
+    _base[block(tail)] = entry._time;
+
+    return _ring.push(PackedMotionEntry(entry, 0));
+  }
+
+  // consumer side; sizes and offsets are in slots, padding slots included
+  const uint32_t size() const
+  {
+    return _ring.size();
+  }
+
+  const bool isPadding(const uint32_t which) const
+  {
+    return _ring.peek(which).isPadding();
+  }
+
+  const MotionEntry peek(const uint32_t which) const
+  {
+    return _ring.peek(which).expand(_base[block(_ring.head() + which)]);
+  }
+
+  void pop(const uint32_t count)
+  {
+    _ring.pop(count);
+  }
+
+  static const uint32_t capacity()
+  {
+    return N;
+  }
+
+protected:
+  static const uint32_t _blockMask = B - 1;
+
+  static const uint32_t block(const uint32_t slot)
+  {
+    return (slot / B) & (N / B - 1);
+  }
+
+  RingBuffer<PackedMotionEntry, N> _ring;
+  time_t _base[N / B];
+};
@@ -8,8 +8,11 @@
 #include "MotionTracker.h"
 
 
-MotionTracker::MotionTracker (const int32_t ringSize, const int interruptPin)
- : _ring(ringSize)
+MotionTracker::MotionTracker (const int interruptPin)
+ : _tcpSink("ec2-54-175-5-136.compute-1.amazonaws.com", 32768)
+ , _udpSink("ec2-54-175-5-136.compute-1.amazonaws.com", 32768)
+ , _ring(&_tcpSink)
+ , _spill(_flash)
  , _sleepTimer(30000, &MotionTracker::noActivity, *this, true)
  , _blinkTimer(10, &MotionTracker::turnLEDOff, *this, true)
  , _streamIntervalTimer(1000, &MotionTracker::stopStreaming, *this, true)
@@ -17,10 +20,14 @@ MotionTracker::MotionTracker (const int32_t ringSize, const int interruptPin)
  , _publishDigestTimer(15000, &MotionTracker::publishDigest, *this, false)
  , _reactivateInterruptTimer(1000, &MotionTracker::reactivateInterrupt, *this, true)
  , _digest()
+ , _missedEvents(0)
+ , _sleepRequested(false)
+ , _worker(NULL)
  , _lastActivityTime(0)
  , _boardLED(D7)
  , _interruptPin(interruptPin)
 {
+  _ring.setClock(&_clock);
   _digest.dump();
 }
 
@@ -36,6 +43,9 @@ void
 MotionTracker::begin()
 {
   pinMode(_boardLED, OUTPUT);
+  _ring.setIdentity(System.deviceID());
+  beginSpill();
+  (void) _ring.restore();
 
   monitorAccelerometer();
   accelerometer.logControlRegs();
@@ -43,6 +53,24 @@ MotionTracker::begin()
   Particle.function("sleep-time", &MotionTracker::setSleepTime, this);
   Particle.function("interval", &MotionTracker::setIntervalTime, this);
   Particle.function("streaming", &MotionTracker::setStreamingTime, this);
+  Particle.function("wire-format", &MotionTracker::setWireFormat, this);
+  Particle.function("overflow", &MotionTracker::setOverflow, this);
+  Particle.function("upload-host", &MotionTracker::setUploadHost, this);
+  Particle.function("activity", &MotionTracker::queryActivity, this);
+
+  if (!_worker)
+  {
+    _worker = new Thread("motion", [this]() { motionWorker(); });
+  }
+}
+
+void
+MotionTracker::beginSpill()
+{
+  if (_flash.begin(FLASH_CHIP_SELECT) && _spill.begin())
+  {
+    _ring.setSpill(&_spill);
+  }
 }
 
 void
@@ -54,7 +82,19 @@ MotionTracker::publishDigest()
 const int16_t
 MotionTracker::upload(const int16_t hunk)
 {
-  return _ring.empty(hunk);
+  // a digest publish asked for from the button goes a message at a time, between the ring's uploads
+  (void) _digest.publish();
+
+  int16_t sent = _ring.drain(hunk);
+
+  // the ring has one consumer, this thread: the sleep timer only asks, and the ring is retained from here once the
+  // drain is done
+  if (_sleepRequested.exchange(false))
+  {
+    suspendSelf();
+  }
+
+  return sent;
 }
 
 int
@@ -75,6 +115,107 @@ MotionTracker::setStreamingTime(String command)
   return setTimer(command, _streamingTimer, "streaming");
 }
 
+int
+MotionTracker::setWireFormat(String command)
+{
+  Log.info("received new wire format '%s'", command.c_str());
+  if (command == "binary")
+  {
+    _ring.setFormat(NetworkRingBuffer::binary);
+  }
+  else if (command == "csv")
+  {
+    _ring.setFormat(NetworkRingBuffer::csv);
+  }
+  else if (command == "acked")
+  {
+    _ring.setFormat(NetworkRingBuffer::acknowledged);
+  }
+  else
+  {
+    Log.warn("unknown wire format %s; expected 'csv', 'binary' or 'acked'", command.c_str());
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+MotionTracker::setOverflow(String command)
+{
+  Log.info("received new overflow policy '%s'", command.c_str());
+  if (command == "reject")
+  {
+    _ring.setOverflow(NetworkRingBuffer::rejectNewest);
+  }
+  else if (command == "oldest")
+  {
+    _ring.setOverflow(NetworkRingBuffer::dropOldest);
+  }
+  else if (command == "decimate")
+  {
+    _ring.setOverflow(NetworkRingBuffer::decimate);
+  }
+  else
+  {
+    Log.warn("unknown overflow policy %s; expected 'reject', 'oldest' or 'decimate'", command.c_str());
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+MotionTracker::setUploadHost(String command)
+{
+  // [tcp://|udp://]host:port, e.g. to point the device at a workstation running host/receiver
+  char host[64];
+  unsigned int port;
+  const char *endpoint = command.c_str();
+  NetworkSink *sink = &_tcpSink;
+
+  Log.info("received new upload host '%s'", endpoint);
+  if (!strncmp(endpoint, "udp://", 6))
+  {
+    sink = &_udpSink;
+    endpoint += 6;
+  }
+  else if (!strncmp(endpoint, "tcp://", 6))
+  {
+    endpoint += 6;
+  }
+
+  if ((sscanf(endpoint, "%63[^:]:%u", host, &port) != 2) || (port == 0) || (port > 65535))
+  {
+    Log.warn("could not parse host:port from %s", command.c_str());
+    return 0;
+  }
+  sink->setEndpoint(host, port);
+  _ring.setSink(sink);
+
+  return 1;
+}
+
+int
+MotionTracker::queryActivity(String command)
+{
+  // from,to in epoch seconds, or seconds back from now when not positive: "-86400,0" is the last day
+  long from, to;
+  time_t now = Time.now();
+
+  if (sscanf(command, "%ld,%ld", &from, &to) != 2)
+  {
+    Log.warn("could not parse from,to from %s", command.c_str());
+    return -1;
+  }
+  time_t start = (from > 0) ? from : now + from;
+  time_t end = (to > 0) ? to : now + to;
+  uint32_t activity = _digest.activity(start, end);
+  Log.info("activity from %ld to %ld is %lu", (long) start, (long) end, activity);
+
+  return (activity < 0x7FFFFFFF) ? activity : 0x7FFFFFFF;
+}
+
 int
 MotionTracker::setTimer(String command, Timer &timer, String name)
 {
@@ -106,7 +247,7 @@ MotionTracker::sampleStream()
   if (accelerometer.xyzReady())
   {
     accelerometer.xyz(measurement._x, measurement._y, measurement._z);
-    measurement._time = Time.now();
+    _clock.stamp(measurement);
     measurement._mode = 's';
 
     _ring.fill(measurement);
@@ -129,8 +270,9 @@ MotionTracker::turnLEDOff()
 void
 MotionTracker::suspendSelf()
 {
-  Log.info("preparing to sleep - sending remaining buffer data");
-  upload(_ring.spaceLeft());
+  Log.info("preparing to sleep - keeping remaining buffer data");
+  _ring.retain();
+  _ring.closeSession();
   Log.info("going to sleep now");
   Serial.flush();
   detachInterrupt(_interruptPin);	// interrupt also wired to WKUP pin
@@ -156,7 +298,7 @@ void
 MotionTracker::noActivity()
 {
   Log.info("looks like no more motion detected\n");
-  suspendSelf();
+  _sleepRequested = true;
 }
 
 void
@@ -184,28 +326,78 @@ void
 MotionTracker::blinkNotify()
 {
   digitalWrite(_boardLED, HIGH);
-  _blinkTimer.resetFromISR();
+  _blinkTimer.reset();
 }
 
 void
 MotionTracker::motionDetected()
 {
-  logEvery(100000);
-  blinkNotify();
+  // the isr only latches the edge: the axes have to be read before the sensor moves on, everything else waits
+  // for processMotion() on the worker thread
+  MotionEvent event;
+
+  event._ticks = System.ticks();
+  accelerometer.xyz(event._x, event._y, event._z);
+  if (!_events.push(event))
+  {
+    _missedEvents++;
+  }
+}
+
+const uint32_t
+MotionTracker::processMotion()
+{
+  uint32_t processed = 0;
+  uint32_t missed = _missedEvents.exchange(0);
+
+  if (missed)
+  {
+    Log.warn("motion event queue full; %lu interrupts lost", missed);
+  }
+  // activity from before the rtc was set goes into the digest as soon as its minutes can be told
+  if (_digest.unplaced() && _clock.epochKnown())
+  {
+    _digest.place((time_t) (_clock.unsetToEpoch() / 1000000));
+  }
+
+  while (_events.size())
+  {
+    const MotionEvent &event = _events.peek(0);
+
+    // date the entry by the edge rather than by now; ticks wrap every 35 s at 120 MHz, far longer than an event waits
+    MotionEntry measurement(0, 'i', event._x, event._y, event._z);
+    _clock.stamp(measurement, event._ticks);
+    _events.pop(1);
+    processed++;
 
-  int16_t x, y, z;
-  accelerometer.xyz(x, y, z);
-  Log.trace("data: %d %d %d", x, y, z);
-  MotionEntry measurement(Time.now(), 'i', x, y, z);
-  _ring.fill(measurement);
-  _digest.registerActivity(measurement);
+    logEvery(100000);
+    blinkNotify();
+    Log.trace("data: %d %d %d", measurement._x, measurement._y, measurement._z);
+    _ring.fill(measurement);
+    _digest.registerActivity(measurement);
 
-  _sleepTimer.resetFromISR();
+    _sleepTimer.reset();
+    _sleepRequested = false;
 #ifdef NOT_TODAY
-  _streamIntervalTimer.resetFromISR();
-  _streamingTimer.resetFromISR();
+    _streamIntervalTimer.reset();
+    _streamingTimer.reset();
 #endif
-  _reactivateInterruptTimer.resetFromISR();
+    _reactivateInterruptTimer.reset();
+  }
+
+  return processed;
+}
+
+void
+MotionTracker::motionWorker()
+{
+  while (true)
+  {
+    // also keeps the sample clock from missing a wrap of the cycle counter
+    processMotion();
+    (void) _clock.now();
+    delay(MOTION_WORKER_PERIOD);
+  }
 }
 
 void
@@ -11,13 +11,42 @@
 #include "lis331.h"
 #include "NetworkRingBuffer.h"
 #include "ActivityDigest.h"
+#include "MotionClock.h"
+#include "RingBuffer.h"
+
+// motion interrupts awaiting the worker thread; a power of two.  interrupts are re-armed a second apart, so the
+// queue only fills if the worker is starved for that many seconds
+#ifndef MOTION_EVENT_QUEUE
+#define MOTION_EVENT_QUEUE 16
+#endif
+
+// how often the worker thread looks for motion interrupts, in ms
+#ifndef MOTION_WORKER_PERIOD
+#define MOTION_WORKER_PERIOD 10
+#endif
+
+// chip select of the spi flash the ring spills to, on the accelerometer's bus; without one the ring drops entries
+// when full, as it always has
+#ifndef FLASH_CHIP_SELECT
+#define FLASH_CHIP_SELECT D5
+#endif
+
+// what the motion isr captures: when the edge came, in System.ticks(), and the axes it latched
+typedef struct MotionEvent
+{
+  uint32_t _ticks;
+  int16_t _x;
+  int16_t _y;
+  int16_t _z;
+} MotionEvent;
 
 class MotionTracker
 {
 public:
-  MotionTracker (const int32_t ringSize, const int pin);
+  MotionTracker (const int pin);
   virtual ~MotionTracker ();
   void begin();
+  void beginSpill();
   const int16_t upload(const int16_t);
 
 //protected:
@@ -26,11 +55,17 @@ public:
   int setSleepTime(String);
   int setIntervalTime(String);
   int setStreamingTime(String);
+  int setWireFormat(String);
+  int setOverflow(String);
+  int setUploadHost(String);
+  int queryActivity(String);
 
   void blinkNotify();
   void logEvery(const uint32_t);
   void monitorAccelerometer();
   void motionDetected();
+  const uint32_t processMotion();
+  void motionWorker();
   void noActivity();
   void sampleStream();
   void stopStreaming();
@@ -39,7 +74,11 @@ public:
   void publishDigest();
   void reactivateInterrupt();
 
+  TcpSink _tcpSink;
+  UdpSink _udpSink;
   NetworkRingBuffer _ring;
+  SpiFlash _flash;
+  FlashLog _spill;
   LIS331 accelerometer;
   Timer _sleepTimer;
   Timer _blinkTimer;
@@ -48,6 +87,11 @@ public:
   Timer _publishDigestTimer;
   Timer _reactivateInterruptTimer;
   ActivityDigest _digest;
+  MotionClock _clock;
+  RingBuffer<MotionEvent, MOTION_EVENT_QUEUE> _events;
+  std::atomic<uint32_t> _missedEvents;
+  std::atomic<bool> _sleepRequested;	// set by the sleep timer; loop() sleeps once its upload is done
+  Thread *_worker;
 
   volatile uint32_t _lastActivityTime;
   int _boardLED;
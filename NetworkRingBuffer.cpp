@@ -7,122 +7,1218 @@
 
 #include "NetworkRingBuffer.h"
 
-NetworkRingBuffer::NetworkRingBuffer (const int32_t length)
-  : _length(length)
-  , _head(0)
-  , _tail(0)
+NetworkRingBuffer::NetworkRingBuffer (UploadSink *sink)
+  : _sink(sink)
+  , _clock(NULL)
+  , _awaitingEpoch(false)
+  , _ring()
+  , _dropped(0)
+  , _thinned(0)
+  , _thinning(0)
+  , _format(csv)
+  , _overflow(rejectNewest)
+  , _lowWater(128)
+  , _idleTimeout(15000)
+  , _drainBudget(4000)
+  , _lastWrite(0)
+  , _staged(0)
+  , _stagedBase(0)
+  , _stagedSlots(0)
+  , _stagedEntries(0)
+  , _datagramFrame(false)
+  , _perWrite(false)
+  , _ackTimeout(5000)
+  , _nextSequence(HAL_RNG_GetRandomNumber())
+  , _inFlight(0)
+  , _priorityInFlight(0)
+  , _spill(NULL)
+  , _spillInFlight(0)
+  , _spillDated(false)
+  , _spillFull(false)
+  , _windowFirst(0)
+  , _windowCount(0)
+  , _windowSent(0)
+  , _ackLength(0)
 {
-  _buffer = new MotionEntry[_length];
+  _identity[0] = '\0';
 }
 
 NetworkRingBuffer::~NetworkRingBuffer ()
 {
-  delete[] _buffer;
 }
 
 const bool
 NetworkRingBuffer::fill(const MotionEntry &entry)
 {
-  // must be atomic here; can be called from isr or from timer
+  bool stored;
+  bool thin = false;
+
+  // both the accelerometer isr and the streaming timer produce; keep them from interleaving a push.
+  // this is only a slot copy and a store, the consumer side never masks interrupts
   ATOMIC_BLOCK()
   {
-    int32_t offset = (_head > _tail)? 0 : _length;
+    if ((_overflow == decimate) && (entry._mode == 's'))
+    {
+      thin = ((_thinning++ & (thinning() - 1)) != 0);
+    }
+    // interrupt samples take the priority lane while it has room
+    stored = !thin && (((entry._mode == 'i') && _priority.push(entry)) || _ring.push(entry));
+  }
+
+  if (thin)
+  {
+    _thinned++;
+    return true;
+  }
+  if (!stored)
+  {
+    _dropped++;
+    Log.error("ring buffer full (%lu entries, %lu dropped).  too bad!", _ring.size(), _dropped.load());
+    return false;
+  }
+
+  return true;
+}
+
+const int16_t
+NetworkRingBuffer::empty(const int16_t hunkSize)
+{
+  if (acknowledging())
+  {
+    return emptyAcknowledged(hunkSize);
+  }
+  if (priorityPending())
+  {
+    return emptyPriority();
+  }
+  if (spillPending())
+  {
+    return emptySpilled(hunkSize);
+  }
+
+  int32_t hunksSent = 0;  // entries, as opposed to slots
+  uint32_t available = _ring.size();
 
-    if ((_head + offset) - _tail == 1)
+  if (available)
+  {
+    Log.trace("there is work to be done");
+
+    if (available >= (uint32_t) hunkSize)
     {
-      Log.error("ring buffer full (%ld vs %ld).  too bad!", _head, _tail);
-      return false;
+      if (!datable(_ring, 0, hunkSize))
+      {
+	return hunksSent;
+      }
+      if (!openSession())
+      {
+	return hunksSent;
+      }
+
+      Log.info("starting backlog upload");
+      int32_t slotsSent = 0;
+      sendHunk(_ring, 0, hunkSize, slotsSent, hunksSent);
+      Log.trace("backlog sent");
+
+      _ring.pop(slotsSent);
     }
     else
     {
-      Log.trace("plenty of room at the inn");
+      Log.trace("not enough to be troubled (%lu vs %d)", available, hunkSize);
     }
-    _buffer[_tail] = entry;
-    _tail ++;
-    _tail %= _length;
   }
+  return hunksSent;
+}
 
-  return true;
+const int16_t
+NetworkRingBuffer::emptyPriority()
+{
+  // interrupt samples go out as soon as there are any, ahead of older streamed samples and spilled entries alike
+  uint32_t slots = priorityHunk(0);
+  if (!datable(_priority, 0, slots) || !openSession())
+  {
+    return 0;
+  }
+
+  int32_t slotsSent = 0;
+  int32_t entriesSent = 0;
+  (void) sendHunk(_priority, 0, slots, slotsSent, entriesSent);
+  _priority.pop(slotsSent);
+
+  return entriesSent;
+}
+
+const uint32_t
+NetworkRingBuffer::priorityHunk(const uint32_t offset) const
+{
+  uint32_t slots = _priority.size() - offset;
+
+  return (slots < NETWORK_PRIORITY_HUNK) ? slots : NETWORK_PRIORITY_HUNK;
+}
+
+const bool
+NetworkRingBuffer::priorityPending() const
+{
+  return _priority.size() > _priorityInFlight;
 }
 
 const int16_t
-NetworkRingBuffer::empty(const int16_t hunkSize)
+NetworkRingBuffer::emptySpilled(const int16_t hunkSize)
 {
-  int32_t startingTail;
-  int32_t hunksSent = 0;
+  // what spilled to flash is older than anything in the ring, so it goes first
+  uint32_t records = spilledHunk(0, hunkSize);
+  if (!records || !openSession())
+  {
+    return 0;
+  }
 
-  ATOMIC_BLOCK()
+  uint32_t recordsSent = 0;
+  int32_t entriesSent = 0;
+  (void) sendSpilled(0, records, recordsSent, entriesSent);
+  _spill->consume(recordsSent);
+
+  return entriesSent;
+}
+
+const uint32_t
+NetworkRingBuffer::spilledHunk(const uint32_t offset, const int16_t hunkSize)
+{
+  // whole records from 'offset' on, about a hunk's worth of entries; none until the first can be dated
+  uint32_t records = 0;
+  uint32_t entries = 0;
+
+  dateSpill();
+  _awaitingEpoch = false;
+  for (bool more = _spill->seek(offset); more && (entries < (uint32_t) hunkSize); more = _spill->advance())
   {
-    startingTail = _tail;
+    if (_spill->epochUnknown() && _clock && !_clock->epochKnown())
+    {
+      Log.trace("holding back spilled entries until the rtc is set");
+      _awaitingEpoch = true;
+      break;
+    }
+    entries += _spill->recordEntries();
+    records++;
   }
 
-  int32_t offset = (startingTail > _head)? 0 : _length;
+  return records;
+}
+
+const int16_t
+NetworkRingBuffer::emptyAcknowledged(const int16_t hunkSize)
+{
+  // entries stay in the ring until the receiver acknowledges the frame carrying them.  up to
+  // NETWORK_ACK_WINDOW hunks may be outstanding; after a timeout or a dropped session the whole window is resent,
+  // in order and with the same sequence numbers, so the receiver can discard anything it already has
+  pollAcks();
 
-  if (startingTail != _head)
+  if (_windowSent && (millis() - _window[_windowFirst]._sentAt > _ackTimeout))
   {
-    Log.trace("there is work to be done");
+    Log.warn("no ack for hunk %lu after %lu ms; resending window of %u", _window[_windowFirst]._sequence, _ackTimeout, _windowCount);
+    closeSession();
+  }
+
+  bool resend = (_windowSent < _windowCount);
+  uint32_t sequence = _nextSequence;
+  uint32_t slots = hunkSize;
+  uint32_t records = 0;
+  uint32_t prioritySlots = 0;
+
+  if (resend)
+  {
+    Hunk &hunk = _window[(_windowFirst + _windowSent) % NETWORK_ACK_WINDOW];
+    sequence = hunk._sequence;
+    slots = hunk._slots;
+    records = hunk._records;
+    prioritySlots = hunk._prioritySlots;
+  }
+  else if (_windowCount == NETWORK_ACK_WINDOW)
+  {
+    return 0;
+  }
+  else if (priorityPending())
+  {
+    // the priority lane goes ahead of everything, flash included
+    slots = 0;
+    prioritySlots = priorityHunk(_priorityInFlight);
+    if (!datable(_priority, _priorityInFlight, prioritySlots))
+    {
+      return 0;
+    }
+  }
+  else if (_spill && (_spill->records() > _spillInFlight))
+  {
+    // spilled entries are the oldest: the ring waits until they are all in flight
+    slots = 0;
+    if (!(records = spilledHunk(_spillInFlight, hunkSize)))
+    {
+      return 0;
+    }
+  }
+  else if ((_ring.size() - _inFlight < slots) || !datable(_ring, _inFlight, slots))
+  {
+    return 0;
+  }
+
+  if (!openSession())
+  {
+    return 0;
+  }
+
+  int32_t slotsSent = 0;
+  int32_t entriesSent = 0;
+  uint32_t recordsSent = 0;
+  bool sent;
+  if (prioritySlots)
+  {
+    sent = sendHunk(_priority, _priorityInFlight, prioritySlots, slotsSent, entriesSent, true, sequence);
+  }
+  else if (records)
+  {
+    sent = sendSpilled(_spillInFlight, records, recordsSent, entriesSent, true, sequence);
+  }
+  else
+  {
+    sent = sendHunk(_ring, _inFlight, slots, slotsSent, entriesSent, true, sequence);
+  }
+  if (!sent)
+  {
+    return 0;
+  }
+
+  Hunk &hunk = _window[(_windowFirst + _windowSent) % NETWORK_ACK_WINDOW];
+  hunk._sequence = sequence;
+  hunk._slots = slots;
+  hunk._records = records;
+  hunk._prioritySlots = prioritySlots;
+  hunk._sentAt = millis();
+  _inFlight += slots;
+  _spillInFlight += records;
+  _priorityInFlight += prioritySlots;
+  _windowSent++;
+  if (!resend)
+  {
+    _windowCount++;
+    _nextSequence++;
+  }
+
+  return entriesSent;
+}
+
+void
+NetworkRingBuffer::pollAcks()
+{
+  while (_sink->isOpen())
+  {
+    int got = _sink->read(&_ack[_ackLength], sizeof(_ack) - _ackLength);
+    if (got <= 0)
+    {
+      break;
+    }
+    _ackLength += got;
+
+    uint32_t sequence;
+    int used = WireFormat::decodeAck(_ack, _ackLength, sequence);
+    if (used < 0)
+    {
+      Log.warn("garbled ack from receiver; dropping session");
+      closeSession();
+      return;
+    }
+    if (used == 0)
+    {
+      continue;
+    }
+    _ackLength = 0;
 
-    if ((startingTail + offset) - _head >= hunkSize)
+    // acks are cumulative
+    while (_windowSent && WireFormat::sequenceAtOrBefore(_window[_windowFirst]._sequence, sequence))
     {
-      if (!_client.connected())
+      Hunk &hunk = _window[_windowFirst];
+      Log.trace("hunk %lu acknowledged", hunk._sequence);
+      _ring.pop(hunk._slots);
+      _inFlight -= hunk._slots;
+      _priority.pop(hunk._prioritySlots);
+      _priorityInFlight -= hunk._prioritySlots;
+      if (hunk._records)
       {
-	Log.info("connecting to aws");
-	if (!_client.connect("ec2-54-175-5-136.compute-1.amazonaws.com", 32768))
-	{
-	  Log.warn("cannot connect to aws");
-	  return hunksSent;
-	}
+	_spill->consume(hunk._records);
+	_spillInFlight -= hunk._records;
       }
+      _windowFirst = (_windowFirst + 1) % NETWORK_ACK_WINDOW;
+      _windowSent--;
+      _windowCount--;
+    }
+  }
+}
 
-      Log.info("starting backlog upload");
-      int32_t ringIndex;
-      for (int32_t i = _head; i < _head + hunkSize; i++)
+template <typename Lane>
+const bool
+NetworkRingBuffer::sendHunk(const Lane &lane, const uint32_t offset, const uint32_t slots, int32_t &slotsSent, int32_t &entriesSent, const bool sequenced, const uint32_t sequence)
+{
+  // a hunk spans 'slots' slots of a lane starting 'offset' past its head; block padding in there is skipped rather
+  // than sent
+  uint32_t entries = 0;
+  int32_t first = -1;
+  for (uint32_t i = offset; i < offset + slots; i++)
+  {
+    if (!lane.isPadding(i))
+    {
+      first = (first < 0) ? i : first;
+      entries++;
+    }
+  }
+
+  beginHunk(entries, entries ? entryAt(lane, first)._time : 0, sequenced, sequence);
+
+  bool healthy = true;
+  for (uint32_t i = offset; healthy && (i < offset + slots); i++)
+  {
+    if (lane.isPadding(i))
+    {
+      healthy = stage(NULL, slotsSent, entriesSent);
+    }
+    else
+    {
+      Log.trace("staging hunk %lu", i);
+      MotionEntry entry = entryAt(lane, i);
+      healthy = stage(&entry, slotsSent, entriesSent);
+    }
+  }
+
+  return healthy && flush(slotsSent, entriesSent);
+}
+
+const bool
+NetworkRingBuffer::sendSpilled(const uint32_t offset, const uint32_t records, uint32_t &recordsSent, int32_t &entriesSent, const bool sequenced, const uint32_t sequence)
+{
+  // the same as sendHunk() for 'records' flash log records from 'offset' past the oldest, each entry a slot.  the
+  // frame header wants the entry count and a base time up front
+  uint32_t entries = 0;
+  time_t base = 0;
+  bool more = _spill->seek(offset);
+  for (uint32_t i = 0; more && (i < records); i++)
+  {
+    MotionEntry entry;
+    if (!entries && _spill->next(entry))
+    {
+      date(entry);
+      base = entry._time;
+    }
+    entries += _spill->recordEntries();
+    more = (i + 1 < records) && _spill->advance();
+  }
+
+  int32_t slotsSent = 0;
+  bool healthy = true;
+  beginHunk(entries, base, sequenced, sequence);
+  more = _spill->seek(offset);
+  for (uint32_t i = 0; healthy && more && (i < records); i++)
+  {
+    MotionEntry entry;
+    while (healthy && _spill->next(entry))
+    {
+      date(entry);
+      healthy = stage(&entry, slotsSent, entriesSent);
+    }
+    more = (i + 1 < records) && _spill->advance();
+  }
+  healthy = healthy && flush(slotsSent, entriesSent);
+
+  // only records whose every entry went out count as sent
+  uint32_t covered = 0;
+  recordsSent = 0;
+  more = _spill->seek(offset);
+  while (more && (recordsSent < records) && ((covered += _spill->recordEntries()) <= (uint32_t) slotsSent))
+  {
+    recordsSent++;
+    more = _spill->advance();
+  }
+
+  return healthy;
+}
+
+void
+NetworkRingBuffer::beginHunk(const uint32_t entries, const time_t base, const bool sequenced, const uint32_t sequence)
+{
+  _staged = 0;
+  _stagedSlots = 0;
+  _stagedBase = 0;
+  _stagedEntries = 0;
+  _datagramFrame = false;
+  if (sequenced)
+  {
+    _staged = _encoder.begin(_staging, entries, base, sequence);
+    _stagedBase = _staged;
+  }
+  else if ((_format != csv) && entries && !_sink->datagrams())
+  {
+    _staged = _encoder.begin(_staging, entries, base);
+    _stagedBase = _staged;
+  }
+
+  // datagram sinks lose or reorder writes independently, so there each write carries a frame of its own
+  _perWrite = (_format != csv) && !sequenced && _sink->datagrams();
+}
+
+const bool
+NetworkRingBuffer::stage(const MotionEntry *entry, int32_t &slotsSent, int32_t &entriesSent)
+{
+  // serialize into the staging buffer and write it out whenever the next entry would not fit.  a slot without an
+  // entry (block padding) adds no bytes
+  if (!entry)
+  {
+    _stagedEnd[_stagedSlots++] = _staged;
+  }
+  else
+  {
+    if (_perWrite && !_staged)
+    {
+      beginDatagram(*entry);
+    }
+    unsigned int lineSize = serialize(*entry);
+
+    if (_staged + lineSize > sizeof(_staging))
+    {
+      if (!flush(slotsSent, entriesSent))
       {
-	ringIndex = i%_length;
-	Log.trace("sending hunk %ld (index %ld) ", i, ringIndex);
-	MotionEntry *entry = &_buffer[ringIndex];
-	unsigned int lineSize = sprintf(_line, "%s,%c,%d,%d,%d\n", Time.format(entry->_time, TIME_FORMAT_ISO8601_FULL).c_str(), entry->_mode, entry->_x, entry->_y, entry->_z);
-
-	if (lineSize >= sizeof(_line))
-	{
-	  Log.error("buffer overrun!  game over!");
-	  System.reset();
-	}
-
-	if (unsigned int written = _client.write((const uint8_t *)_line, lineSize) != lineSize)
-	{
-	  Log.warn("network write partially failed; will try again later (%d/%d) (hunk %ld)", written, lineSize, i - _head);
-	  break;
-	}
-	hunksSent++;
+	return false;
       }
-      Log.trace("backlog sent");
-      _client.stop();
+      if (_perWrite)
+      {
+	beginDatagram(*entry);
+	lineSize = serialize(*entry);
+      }
+    }
+    memcpy(&_staging[_staged], _line, lineSize);
+    _stagedEntries++;
+    _staged += lineSize;
+    _stagedEnd[_stagedSlots++] = _staged;
+  }
+
+  if (_stagedSlots == sizeof(_stagedEnd) / sizeof(_stagedEnd[0]))
+  {
+    return flush(slotsSent, entriesSent);
+  }
+
+  return true;
+}
+
+const bool
+NetworkRingBuffer::flush(int32_t &slotsSent, int32_t &entriesSent)
+{
+  // one socket write for everything staged; only slots whose bytes went out in full count as sent
+  if (_datagramFrame)
+  {
+    WireFormat::setCount(_staging, _stagedEntries);
+  }
+
+  int written = _staged ? _sink->write(_staging, _staged) : 0;
+  unsigned int delivered = (written > 0) ? written : 0;
+  unsigned int previousEnd = _stagedBase;
+
+  if (delivered >= _stagedBase)
+  {
+    for (unsigned int i = 0; (i < _stagedSlots) && (_stagedEnd[i] <= delivered); i++)
+    {
+      // padding staged ahead of a datagram's first entry was recorded before beginDatagram() put the header in
+      unsigned int end = (_stagedEnd[i] > _stagedBase) ? _stagedEnd[i] : _stagedBase;
+      slotsSent++;
+      entriesSent += (end != previousEnd);
+      previousEnd = end;
+    }
+  }
+
+  bool complete = (delivered == _staged);
+  if (!complete)
+  {
+    Log.warn("network write partially failed; will try again later (%u/%u)", delivered, _staged);
+    // the peer saw a torn line/frame; start over on a fresh connection
+    closeSession();
+  }
+  else if (_staged)
+  {
+    _lastWrite = millis();
+  }
 
-      ATOMIC_BLOCK()
+  _staged = 0;
+  _stagedBase = 0;
+  _stagedSlots = 0;
+  _stagedEntries = 0;
+  _datagramFrame = false;
+
+  return complete;
+}
+
+void
+NetworkRingBuffer::beginDatagram(const MotionEntry &first)
+{
+  // the entry count is filled in once the datagram is full
+  _staged = _encoder.begin(_staging, 0, first._time);
+  _stagedBase = _staged;
+  _datagramFrame = true;
+}
+
+const int32_t
+NetworkRingBuffer::drain(const int16_t hunkSize)
+{
+  // keep the session up and send hunks back to back until the ring is down to the low-water mark.
+  // bounded so loop() still gets control back regularly while a large backlog drains
+  int32_t sent = 0;
+  uint32_t start = millis();
+
+  spill();
+  shed();
+  while (((spaceLeft() > (int32_t) _lowWater) || spillPending() || priorityPending()) && (millis() - start < _drainBudget))
+  {
+    int16_t hunk = empty(hunkSize);
+    spill();
+    shed();
+
+    if (hunk <= 0)
+    {
+      // with a full window there is nothing to do but wait for acks
+      if (!acknowledging() || !_windowSent)
       {
-	_head += hunksSent;
-	_head %= _length;
+	break;
       }
+      delay(10);
+      continue;
     }
-    else
+    sent += hunk;
+  }
+
+  if (sent)
+  {
+    Log.info("drained %ld entries in %lu ms, %lu remain", sent, millis() - start, _ring.size());
+  }
+  idle();
+
+  return sent;
+}
+
+void
+NetworkRingBuffer::idle()
+{
+  if (_sink->isOpen() && (millis() - _lastWrite > _idleTimeout))
+  {
+    Log.info("upload session idle for %lu ms; closing", millis() - _lastWrite);
+    closeSession();
+  }
+}
+
+const bool
+NetworkRingBuffer::openSession()
+{
+  if (_sink->isOpen())
+  {
+    return true;
+  }
+  if (!_sink->open())
+  {
+    return false;
+  }
+  _lastWrite = millis();
+
+  // binary sessions introduce the device so the receiver can keep streams apart
+  if ((_format != csv) && !_sink->datagrams() && _identity[0])
+  {
+    uint8_t hello[4 + WireFormat::maxDeviceId];
+    int size = WireFormat::encodeHello(hello, _identity);
+    if (_sink->write(hello, size) != size)
     {
-      Log.trace("not enough to be troubled (%ld vs %ld)", _head, startingTail);
+      Log.warn("could not introduce ourselves to the receiver");
+      closeSession();
+      return false;
     }
   }
-  return hunksSent;
+
+  return true;
+}
+
+const bool
+NetworkRingBuffer::acknowledging() const
+{
+  // acks need an ordered stream to come back on; over datagrams acknowledged mode degrades to plain binary frames
+  return (_format == acknowledged) && !_sink->datagrams();
+}
+
+void
+NetworkRingBuffer::closeSession()
+{
+  _sink->close();
+  _ackLength = 0;
+
+  // anything unacknowledged has to go out again on the next session
+  _inFlight = 0;
+  _spillInFlight = 0;
+  _priorityInFlight = 0;
+  _windowSent = 0;
 }
 
 const int16_t
 NetworkRingBuffer::spaceLeft() const
 {
-  int16_t remainingEntries;
+  // entries not yet sent; in acknowledged mode entries awaiting an ack are not counted
+  return _ring.size() - _inFlight;
+}
+
+const uint32_t
+NetworkRingBuffer::priorityBacklog() const
+{
+  return _priority.size() - _priorityInFlight;
+}
 
-  ATOMIC_BLOCK()
+const uint32_t
+NetworkRingBuffer::dropped() const
+{
+  return _dropped.load();
+}
+
+const uint32_t
+NetworkRingBuffer::thinned() const
+{
+  return _thinned.load();
+}
+
+template <typename Lane>
+const MotionEntry
+NetworkRingBuffer::entryAt(const Lane &lane, const uint32_t slot) const
+{
+  MotionEntry entry = lane.peek(slot);
+
+  date(entry);
+
+  return entry;
+}
+
+void
+NetworkRingBuffer::date(MotionEntry &entry) const
+{
+  if (_clock)
+  {
+    (void) _clock->toEpoch(entry);
+  }
+}
+
+template <typename Lane>
+const bool
+NetworkRingBuffer::datable(const Lane &lane, const uint32_t offset, const uint32_t slots)
+{
+  // entries stamped before the epoch was known wait in the ring until it is; they are never sent on the unset rtc's
+  // count
+  _awaitingEpoch = false;
+  if (!_clock || _clock->epochKnown())
+  {
+    return true;
+  }
+
+  for (uint32_t i = offset; i < offset + slots; i++)
+  {
+    if (!lane.isPadding(i) && lane.peek(i)._epochUnknown)
+    {
+      Log.trace("holding back entries until the rtc is set");
+      _awaitingEpoch = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const unsigned int
+NetworkRingBuffer::serialize(const MotionEntry &entry)
+{
+  if (_format != csv)
+  {
+    return _encoder.encode((uint8_t *)_line, entry);
+  }
+
+  // ISO8601 with the microseconds, in utc whatever Time.zone() is, as the receivers parse it
+  unsigned int lineSize = WireFormat::formatCsv(_line, sizeof(_line), entry);
+
+  if (lineSize >= sizeof(_line))
+  {
+    Log.error("buffer overrun!  game over!");
+    System.reset();
+  }
+
+  return lineSize;
+}
+
+void
+NetworkRingBuffer::setFormat(const format wireFormat)
+{
+  // takes effect at the next hunk boundary, on a fresh session so a binary one starts with its hello;
+  // empty() runs from loop() only
+  if (wireFormat != _format)
+  {
+    // unacknowledged entries are still in the ring and simply go out again in the new format
+    closeSession();
+    _windowCount = 0;
+  }
+  _format = wireFormat;
+}
+
+const NetworkRingBuffer::format
+NetworkRingBuffer::wireFormat() const
+{
+  return _format;
+}
+
+void
+NetworkRingBuffer::setOverflow(const overflow policy)
+{
+  _overflow = policy;
+}
+
+const NetworkRingBuffer::overflow
+NetworkRingBuffer::overflowPolicy() const
+{
+  return _overflow;
+}
+
+void
+NetworkRingBuffer::setSink(UploadSink *sink)
+{
+  // same as a format change: whatever was unacknowledged goes out again through the new sink
+  closeSession();
+  _windowCount = 0;
+  _sink = sink;
+}
+
+void
+NetworkRingBuffer::setIdentity(const char *device)
+{
+  strncpy(_identity, device, sizeof(_identity) - 1);
+  _identity[sizeof(_identity) - 1] = '\0';
+}
+
+void
+NetworkRingBuffer::setLowWater(const uint32_t entries)
+{
+  _lowWater = entries;
+}
+
+void
+NetworkRingBuffer::setIdleTimeout(const uint32_t milliseconds)
+{
+  _idleTimeout = milliseconds;
+}
+
+void
+NetworkRingBuffer::setClock(MotionClock *clock)
+{
+  _clock = clock;
+}
+
+const bool
+NetworkRingBuffer::awaitingEpoch() const
+{
+  return _awaitingEpoch;
+}
+
+void
+NetworkRingBuffer::setSpill(FlashLog *spill)
+{
+  _spill = spill;
+}
+
+const uint32_t
+NetworkRingBuffer::spilled() const
+{
+  return _spill ? _spill->entries() : 0;
+}
+
+const bool
+NetworkRingBuffer::spillPending() const
+{
+  return _spill && (_spill->records() > _spillInFlight);
+}
+
+void
+NetworkRingBuffer::dateSpill()
+{
+  // spilled entries stamped on the unset rtc are placed on the epoch as soon as it is known, by this boot, while it
+  // knows how: one that finds the rtc already set after a reset cannot, and whatever is still unplaced then is lost
+  if (_spillDated || !_spill || !_spill->ready() || !_clock || !_clock->epochKnown())
+  {
+    return;
+  }
+
+  uint32_t lost = _spill->date(_clock->unsetToEpoch(), _clock->unsetSeen());
+  if (lost)
+  {
+    _dropped += lost;
+    Log.error("%lu spilled entries were stamped on an unset rtc this boot never saw; they cannot be dated and are lost", lost);
+  }
+  _spillDated = true;
+}
+
+void
+NetworkRingBuffer::spill()
+{
+  // once the ring is past the spill mark its oldest slots move out to the flash log a block at a time, so an outage
+  // fills flash instead of dropping entries.  this runs from loop(), the ring's consumer: producers never wait on
+  // flash
+  dateSpill();
+  if (!_spill || !_spill->ready() || (_ring.size() < NETWORK_SPILL_MARK))
+  {
+    return;
+  }
+
+  // given up hunks go out again from flash (the receiver may see them twice)
+  if (!releaseWindow())
+  {
+    return;
+  }
+
+  uint32_t spilled = 0;
+  while (_ring.size() >= NETWORK_SPILL_MARK)
+  {
+    uint32_t slots = spillSlots(_ring, spillRecordSlots);
+    _spillFull = !slots;
+    if (!slots)
+    {
+      Log.warn("flash log is full (%lu entries)", _spill->entries());
+      break;
+    }
+    spilled += slots;
+  }
+  if (spilled)
+  {
+    Log.info("spilled %lu slots to flash; %lu entries there", spilled, _spill->entries());
+  }
+}
+
+template <typename Lane>
+const uint32_t
+NetworkRingBuffer::spillSlots(Lane &lane, const uint32_t slots)
+{
+  // one record of a lane's oldest 'slots' slots, encoded in the staging buffer, which is idle between hunks
+  static_assert(WireFormat::headerSize + spillRecordSlots * WireFormat::maxEntrySize <= NETWORK_STAGING_BYTES, "a spilled block must fit in the staging buffer");
+  uint16_t count = 0;
+  uint16_t epochFrom = 0;
+  time_t base = 0;
+
+  for (uint32_t i = slots; i-- > 0; )
+  {
+    if (!lane.isPadding(i))
+    {
+      base = entryAt(lane, i)._time;
+      count++;
+    }
+  }
+
+  size_t length = _encoder.begin(_staging, count, base);
+  for (uint32_t i = 0; i < slots; i++)
+  {
+    if (!lane.isPadding(i))
+    {
+      MotionEntry entry = entryAt(lane, i);
+      length += _encoder.encode(&_staging[length], entry);
+      epochFrom += !entry._epochUnknown;
+    }
+  }
+  if (!_spill->append(_staging, length, count, epochFrom))
+  {
+    return 0;
+  }
+  lane.pop(slots);
+
+  return slots;
+}
+
+void
+NetworkRingBuffer::shed()
+{
+  // dropping oldest: past the shed mark the oldest slots are discarded a block at a time, which leaves the producers
+  // room for what is newest.  like spill() this runs on the consumer side, since only the consumer may move the head
+  if ((_overflow != dropOldest) || (_ring.size() < NETWORK_SHED_MARK) || !releaseWindow())
+  {
+    return;
+  }
+
+  uint32_t lost = 0;
+  while (_ring.size() >= NETWORK_SHED_MARK)
+  {
+    for (uint32_t i = 0; i < spillRecordSlots; i++)
+    {
+      lost += !_ring.isPadding(i);
+    }
+    _ring.pop(spillRecordSlots);
+  }
+  _dropped += lost;
+  Log.warn("ring buffer past %u slots; dropped the oldest %lu entries (%lu dropped)", NETWORK_SHED_MARK, lost, _dropped.load());
+}
+
+const bool
+NetworkRingBuffer::releaseWindow()
+{
+  // hunks of ring slots in the window pin the head of the ring.  with none of them out on a session they are given
+  // up on; false while they are still out
+  for (uint8_t i = 0; i < _windowCount; i++)
+  {
+    if (_window[(_windowFirst + i) % NETWORK_ACK_WINDOW]._slots)
+    {
+      if (_windowSent)
+      {
+	return false;
+      }
+      _windowCount = 0;
+      break;
+    }
+  }
+
+  return true;
+}
+
+const uint32_t
+NetworkRingBuffer::thinning() const
+{
+  // 1 streamed sample in this many is kept: every one below the decimation mark, 1 in 2 past it, and 1 in twice as
+  // many each time the room left halves from there.  while a flash log has room the ring spills to it instead, and
+  // nothing is thinned
+  uint32_t used = _ring.size();
+  uint32_t ratio = 1;
+
+  if ((used >= NETWORK_DECIMATE_MARK) && !(_spill && _spill->ready() && !_spillFull))
+  {
+    ratio = 2;
+    for (uint32_t room = (NETWORK_RING_ENTRIES - NETWORK_DECIMATE_MARK) / 2; room && (NETWORK_RING_ENTRIES - used < room); room /= 2)
+    {
+      ratio *= 2;
+    }
+  }
+
+  return ratio;
+}
+
+void
+NetworkRingBuffer::sendPriority()
+{
+  // before sleep the priority lane goes out first, if the link will take it; what it will not take is retained ahead
+  // of any streamed sample
+  uint32_t slots = _priority.size();
+  int32_t slotsSent = 0;
+  int32_t entriesSent = 0;
+
+  if (slots && datable(_priority, 0, slots) && openSession())
+  {
+    (void) sendHunk(_priority, 0, slots, slotsSent, entriesSent);
+  }
+  _priority.pop(slotsSent);
+}
+
+static const bool
+retainedBefore(const MotionEntry &a, const MotionEntry &b)
+{
+  return (a._epochUnknown == b._epochUnknown) ? WireFormat::micros(a) <= WireFormat::micros(b) : b._epochUnknown;
+}
+
+template <typename F>
+void
+NetworkRingBuffer::merge(const uint32_t priorityFrom, const uint32_t ringFrom, const F &visit) const
+{
+  // the priority lane's slots from 'priorityFrom' and the ring's from 'ringFrom', as one run in time order with the
+  // epoch-unknown entries last, as a retained frame holds them
+  uint32_t p = priorityFrom;
+  uint32_t r = ringFrom;
+  MotionEntry interrupt;
+  MotionEntry sample;
+  bool haveInterrupt = false;
+  bool haveSample = false;
+
+  for (;;)
+  {
+    for ( ; !haveInterrupt && (p < _priority.size()); p++)
+    {
+      if (!_priority.isPadding(p))
+      {
+	interrupt = entryAt(_priority, p);
+	haveInterrupt = true;
+      }
+    }
+    for ( ; !haveSample && (r < _ring.size()); r++)
+    {
+      if (!_ring.isPadding(r))
+      {
+	sample = entryAt(_ring, r);
+	haveSample = true;
+      }
+    }
+    if (!haveInterrupt && !haveSample)
+    {
+      return;
+    }
+
+    bool first = haveInterrupt && (!haveSample || retainedBefore(interrupt, sample));
+    visit(first ? interrupt : sample);
+    haveInterrupt = haveInterrupt && !first;
+    haveSample = haveSample && first;
+  }
+}
+
+const size_t
+NetworkRingBuffer::retainedSize(const uint32_t priorityFrom, const uint32_t ringFrom) const
+{
+  uint8_t scratch[WireFormat::headerSize + WireFormat::maxEntrySize];
+  WireEncoder encoder;
+  size_t size = RetainedTier::frameOverhead();
+  bool first = true;
+
+  merge(priorityFrom, ringFrom, [&](const MotionEntry &entry)
+  {
+    if (first)
+    {
+      // the frame's base is its first entry's second
+      (void) encoder.begin(scratch, 0, entry._time);
+      first = false;
+    }
+    size += encoder.encode(scratch, entry);
+  });
+
+  return size;
+}
+
+const uint32_t
+NetworkRingBuffer::retainedFrom(const uint32_t slots, const uint32_t priorityFrom, const bool ring) const
+{
+  // the first slot of the lane from which on its newest slots still fit in the tier, with the other lane's from
+  // 'priorityFrom' (or none of the ring's, while the priority lane is being fitted).  an entry only ever adds to a
+  // frame, so the first fitting slot is found by bisection
+  uint32_t low = 0;
+  uint32_t high = slots;
+
+  while (low < high)
+  {
+    uint32_t middle = low + (high - low) / 2;
+    size_t size = ring ? retainedSize(priorityFrom, middle) : retainedSize(middle, _ring.size());
+    if (size <= RetainedTier::capacity())
+    {
+      high = middle;
+    }
+    else
+    {
+      low = middle + 1;
+    }
+  }
+
+  return low;
+}
+
+void
+NetworkRingBuffer::retain()
+{
+  // after the sleep the rtc may be set, and this boot's shift onto it gone
+  dateSpill();
+  sendPriority();
+
+  // the newest entries that fit in the tier: interrupt samples first, then streamed samples in the room they leave.
+  // entries awaiting an ack are kept too: they may reach the receiver twice, but are never lost to a session torn
+  // down by sleep
+  uint32_t older = retainedFrom(_priority.size(), 0, false);
+  uint32_t keep = retainedFrom(_ring.size(), older, true);
+
+  // older interrupt samples go to the flash log if there is one; without one they are lost
+  while (older && _spill && _spill->ready())
+  {
+    uint32_t spilled = spillSlots(_priority, (older < spillRecordSlots) ? older : (uint32_t) spillRecordSlots);
+    if (!spilled)
+    {
+      break;
+    }
+    older -= spilled;
+  }
+  uint32_t lost = 0;
+  for (uint32_t i = 0; i < older; i++)
+  {
+    lost += !_priority.isPadding(i);
+  }
+  if (lost)
+  {
+    _dropped += lost;
+    Log.error("could not keep %lu interrupt entries over sleep; they are lost", lost);
+  }
+  _priority.pop(older);
+
+  // older streamed samples go to the flash log if there is one, otherwise over the network before sleeping.  the
+  // tier is all the backup sram the digest leaves, some 100-150 entries against a ring of NETWORK_RING_ENTRIES, so
+  // without a flash log a backlog larger than that is still uploaded before every sleep
+  while (keep && _spill && _spill->ready())
+  {
+    uint32_t spilled = spillSlots(_ring, (keep < spillRecordSlots) ? keep : spillRecordSlots);
+    if (!spilled)
+    {
+      break;
+    }
+    keep -= spilled;
+  }
+  if (keep)
+  {
+    int32_t slotsSent = 0;
+    int32_t entriesSent = 0;
+    if (datable(_ring, 0, keep) && openSession())
+    {
+      Log.info("%lu slots do not fit in retained memory; uploading them", keep);
+      (void) sendHunk(_ring, 0, keep, slotsSent, entriesSent);
+    }
+
+    lost = 0;
+    for (uint32_t i = slotsSent; i < keep; i++)
+    {
+      lost += !_ring.isPadding(i);
+    }
+    if (lost)
+    {
+      _dropped += lost;
+      Log.error("could not upload %lu entries before sleeping; they are lost", lost);
+    }
+    _ring.pop(keep);
+  }
+
+  uint16_t count = 0;
+  uint16_t epochFrom = 0;
+  time_t base = 0;
+  merge(0, 0, [&](const MotionEntry &entry)
+  {
+    base = count ? base : entry._time;
+    count++;
+  });
+
+  _retained.begin(count, base);
+  merge(0, 0, [&](const MotionEntry &entry)
+  {
+    (void) _retained.append(entry);
+    epochFrom += !entry._epochUnknown;
+  });
+  _priority.pop(_priority.size());
+  _ring.pop(_ring.size());
+  _retained.seal(epochFrom);
+
+  // the ring and the priority lane are empty, so the window's hunks point at nothing; spilled records in it go out
+  // again
+  closeSession();
+  _windowCount = 0;
+  Log.info("%u entries retained for after sleep", count);
+}
+
+const uint16_t
+NetworkRingBuffer::restore()
+{
+  MotionEntry entry;
+  uint16_t restored = 0;
+  uint16_t count = _retained.open();
+
+  while (_retained.next(entry) && fill(entry))
+  {
+    restored++;
+  }
+  _retained.invalidate();
+
+  if (count)
   {
-    int32_t offset = (_tail > _head) ? 0 : _length;
-    remainingEntries = (_tail + offset) - _head;
+    Log.info("%u of %u entries restored from before sleep", restored, count);
   }
 
-  return remainingEntries;
+  return restored;
 }
@@ -9,22 +9,201 @@
 
 #include "application.h"
 #include "MotionEntry.h"
+#include "WireFormat.h"
+#include "MotionRing.h"
+#include "NetworkSink.h"
+#include "MotionClock.h"
+#include "RetainedTier.h"
+#include "FlashLog.h"
+
+// ring capacity in entries; a power of two, override with -DNETWORK_RING_ENTRIES=... to resize at build time.
+// entries are stored packed (10 bytes each, see PackedMotionEntry), so 1024 take 10 KB
+#ifndef NETWORK_RING_ENTRIES
+#define NETWORK_RING_ENTRIES 1024
+#endif
+
+// interrupt samples have a lane of their own, sent ahead of the ring and the flash log: a power of two, in entries
+#ifndef NETWORK_PRIORITY_ENTRIES
+#define NETWORK_PRIORITY_ENTRIES 64
+#endif
+
+// the most priority lane slots in one hunk.  the lane never waits for a hunk to fill: whatever is there goes
+#ifndef NETWORK_PRIORITY_HUNK
+#define NETWORK_PRIORITY_HUNK 16
+#endif
+
+// hunks in flight awaiting acknowledgement in acknowledged mode
+#ifndef NETWORK_ACK_WINDOW
+#define NETWORK_ACK_WINDOW 4
+#endif
+
+// uploads are staged and written a tcp segment at a time
+#ifndef NETWORK_STAGING_BYTES
+#define NETWORK_STAGING_BYTES 1460
+#endif
+
+// with a flash log to spill to, the oldest slots go there whenever more than this many are in use
+#ifndef NETWORK_SPILL_MARK
+#define NETWORK_SPILL_MARK (NETWORK_RING_ENTRIES / 2)
+#endif
+
+// overflow policy dropOldest: the oldest unsent slots are discarded whenever more than this many are in use
+#ifndef NETWORK_SHED_MARK
+#define NETWORK_SHED_MARK (NETWORK_RING_ENTRIES * 3 / 4)
+#endif
+
+// overflow policy decimate: streamed samples are thinned 2:1 once this many slots are in use, and twice as hard
+// again each time the room left halves.  not while a flash log has room: the ring spills to it instead
+#ifndef NETWORK_DECIMATE_MARK
+#define NETWORK_DECIMATE_MARK (NETWORK_RING_ENTRIES / 2)
+#endif
 
 class NetworkRingBuffer
 {
 public:
-  NetworkRingBuffer (const int32_t length);
+  enum format
+  {
+    csv = 0,
+    binary = 1,
+    acknowledged = 2	// binary frames carrying sequence numbers; entries are released only once the receiver acks them
+  };
+
+  // what gives when entries come faster than they go out (after the flash log, if there is one)
+  enum overflow
+  {
+    rejectNewest = 0,	// fill() refuses entries while the ring is full
+    dropOldest = 1,	// the consumer keeps room for new entries by discarding the oldest
+    decimate = 2	// streamed samples are thinned as the ring fills; interrupt samples are always kept
+  };
+
+  NetworkRingBuffer (UploadSink *sink);
   virtual ~NetworkRingBuffer ();
 
   const bool fill(const MotionEntry &);
   const int16_t empty(const int16_t hunkSize);
+  const int32_t drain(const int16_t hunkSize);
+  void idle();
+  void closeSession();
   const int16_t spaceLeft() const;
+  // the same for the priority lane
+  const uint32_t priorityBacklog() const;
+  const uint32_t dropped() const;
+  // streamed samples decimation left out
+  const uint32_t thinned() const;
+  void setFormat(const format);
+  const format wireFormat() const;
+  void setOverflow(const overflow);
+  const overflow overflowPolicy() const;
+  void setSink(UploadSink *sink);
+  void setIdentity(const char *device);
+  void setLowWater(const uint32_t entries);
+  void setIdleTimeout(const uint32_t milliseconds);
+  // entries stamped before the epoch was known are held back until this clock can move them onto it
+  void setClock(MotionClock *clock);
+  // the last upload attempt found a hunk it could not date yet
+  const bool awaitingEpoch() const;
+  // before deep sleep: keeps what fits of the unsent entries in retained memory (the newest hundred or so, interrupt
+  // samples ahead of streamed ones) and spills or uploads the rest; restore() puts them back on wake, ahead of
+  // anything new
+  void retain();
+  const uint16_t restore();
+  // a flash log for what does not fit in the ring, drained ahead of it; entries spilled and not yet acknowledged
+  void setSpill(FlashLog *spill);
+  const uint32_t spilled() const;
 
 protected:
-  TCPClient _client;
-  MotionEntry *_buffer;
-  int32_t _length;
-  int32_t _head;
-  int32_t _tail;
+  enum
+  {
+    spillRecordSlots = 32,	// a ring block
+    priorityBlockSlots = 8
+  };
+
+  typedef MotionRing<NETWORK_RING_ENTRIES> BulkLane;
+  typedef MotionRing<NETWORK_PRIORITY_ENTRIES, priorityBlockSlots> PriorityLane;
+
+  const unsigned int serialize(const MotionEntry &);
+  template <typename Lane>
+  const MotionEntry entryAt(const Lane &lane, const uint32_t slot) const;
+  void date(MotionEntry &entry) const;
+  template <typename Lane>
+  const bool datable(const Lane &lane, const uint32_t offset, const uint32_t slots);
+  const bool openSession();
+  const bool acknowledging() const;
+  void beginDatagram(const MotionEntry &first);
+  const bool flush(int32_t &slotsSent, int32_t &entriesSent);
+  template <typename Lane>
+  const bool sendHunk(const Lane &lane, const uint32_t offset, const uint32_t slots, int32_t &slotsSent, int32_t &entriesSent, const bool sequenced = false, const uint32_t sequence = 0);
+  const bool sendSpilled(const uint32_t offset, const uint32_t records, uint32_t &recordsSent, int32_t &entriesSent, const bool sequenced = false, const uint32_t sequence = 0);
+  void beginHunk(const uint32_t entries, const time_t base, const bool sequenced, const uint32_t sequence);
+  const bool stage(const MotionEntry *entry, int32_t &slotsSent, int32_t &entriesSent);
+  const int16_t emptyAcknowledged(const int16_t hunkSize);
+  const int16_t emptyPriority();
+  const uint32_t priorityHunk(const uint32_t offset) const;
+  const bool priorityPending() const;
+  void sendPriority();
+  template <typename F>
+  void merge(const uint32_t priorityFrom, const uint32_t ringFrom, const F &visit) const;
+  const size_t retainedSize(const uint32_t priorityFrom, const uint32_t ringFrom) const;
+  const uint32_t retainedFrom(const uint32_t slots, const uint32_t priorityFrom, const bool ring) const;
+  const int16_t emptySpilled(const int16_t hunkSize);
+  const uint32_t spilledHunk(const uint32_t offset, const int16_t hunkSize);
+  const bool spillPending() const;
+  void dateSpill();
+  void spill();
+  template <typename Lane>
+  const uint32_t spillSlots(Lane &lane, const uint32_t slots);
+  void shed();
+  const bool releaseWindow();
+  const uint32_t thinning() const;
+  void pollAcks();
+
+  typedef struct Hunk
+  {
+    uint32_t _sequence;
+    uint32_t _slots;
+    uint32_t _records;	// flash log records carried instead of ring slots
+    uint32_t _prioritySlots;	// or priority lane slots
+    uint32_t _sentAt;
+  } Hunk;
+
+  UploadSink *_sink;
+  MotionClock *_clock;
+  bool _awaitingEpoch;
+  WireEncoder _encoder;
+  BulkLane _ring;
+  PriorityLane _priority;
+  RetainedTier _retained;
+  std::atomic<uint32_t> _dropped;
+  std::atomic<uint32_t> _thinned;
+  uint32_t _thinning;	// streamed samples offered while decimating; producer side
+  format _format;
+  overflow _overflow;
+  uint32_t _lowWater;
+  uint32_t _idleTimeout;
+  uint32_t _drainBudget;
+  uint32_t _lastWrite;
   char _line[128];
+  uint8_t _staging[NETWORK_STAGING_BYTES];
+  uint16_t _stagedEnd[NETWORK_STAGING_BYTES / 4];	// staging offset just past each slot; padding slots add no bytes
+  unsigned int _staged;
+  unsigned int _stagedBase;	// frame header bytes ahead of the first slot
+  unsigned int _stagedSlots;
+  uint16_t _stagedEntries;
+  bool _datagramFrame;	// staging holds a self-contained frame whose count is patched in at flush
+  bool _perWrite;	// every write is a frame of its own
+  uint32_t _ackTimeout;
+  uint32_t _nextSequence;
+  uint32_t _inFlight;	// slots past the head already sent and awaiting an ack
+  uint32_t _priorityInFlight;	// the same in the priority lane
+  FlashLog *_spill;
+  uint32_t _spillInFlight;	// the same, in flash log records
+  bool _spillDated;	// the flash log has been told the shift onto the epoch
+  std::atomic<bool> _spillFull;	// the last spill found no room; set by the consumer, read by fill()
+  Hunk _window[NETWORK_ACK_WINDOW];
+  uint8_t _windowFirst;
+  uint8_t _windowCount;	// hunks awaiting an ack
+  uint8_t _windowSent;	// of those, how many went out on the current session
+  uint8_t _ack[WireFormat::ackSize];
+  size_t _ackLength;
+  char _identity[WireFormat::maxDeviceId + 1];
 };
@@ -0,0 +1,137 @@
+/*
+ * NetworkSink.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include "NetworkSink.h"
+
+NetworkSink::NetworkSink (const char *host, const uint16_t port)
+{
+  assign(host, port);
+}
+
+void
+NetworkSink::setEndpoint(const char *host, const uint16_t port)
+{
+  // the next open() picks up the new endpoint
+  if (isOpen())
+  {
+    close();
+  }
+  assign(host, port);
+}
+
+void
+NetworkSink::assign(const char *host, const uint16_t port)
+{
+  strncpy(_host, host, sizeof(_host) - 1);
+  _host[sizeof(_host) - 1] = '\0';
+  _port = port;
+}
+
+TcpSink::TcpSink (const char *host, const uint16_t port)
+ : NetworkSink(host, port)
+{
+}
+
+const bool
+TcpSink::open()
+{
+  if (_client.connected())
+  {
+    return true;
+  }
+
+  Log.info("connecting to %s:%u", _host, _port);
+  if (!_client.connect(_host, _port))
+  {
+    Log.warn("cannot connect to %s:%u", _host, _port);
+    return false;
+  }
+
+  return true;
+}
+
+void
+TcpSink::close()
+{
+  _client.stop();
+}
+
+const bool
+TcpSink::isOpen()
+{
+  return _client.connected();
+}
+
+const int
+TcpSink::write(const uint8_t *data, const size_t length)
+{
+  return _client.write(data, length);
+}
+
+const int
+TcpSink::read(uint8_t *data, const size_t length)
+{
+  if (!_client.connected() || (_client.available() <= 0))
+  {
+    return 0;
+  }
+
+  return _client.read(data, length);
+}
+
+UdpSink::UdpSink (const char *host, const uint16_t port)
+ : NetworkSink(host, port)
+ , _open(false)
+{
+}
+
+const bool
+UdpSink::open()
+{
+  if (_open)
+  {
+    return true;
+  }
+
+  _address = WiFi.resolve(_host);
+  if (!_address)
+  {
+    Log.warn("cannot resolve %s", _host);
+    return false;
+  }
+  if (!_udp.begin(0))
+  {
+    Log.warn("cannot open udp socket");
+    return false;
+  }
+  Log.info("sending datagrams to %s:%u", _host, _port);
+  _open = true;
+
+  return true;
+}
+
+void
+UdpSink::close()
+{
+  if (_open)
+  {
+    _udp.stop();
+    _open = false;
+  }
+}
+
+const bool
+UdpSink::isOpen()
+{
+  return _open;
+}
+
+const int
+UdpSink::write(const uint8_t *data, const size_t length)
+{
+  return _udp.sendPacket(data, length, _address, _port);
+}
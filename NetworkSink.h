@@ -0,0 +1,59 @@
+/*
+ * NetworkSink.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include "application.h"
+#include "UploadSink.h"
+
+// shared host:port bookkeeping for the network sinks
+class NetworkSink : public UploadSink
+{
+public:
+  NetworkSink (const char *host, const uint16_t port);
+
+  virtual void setEndpoint(const char *host, const uint16_t port);
+
+protected:
+  void assign(const char *host, const uint16_t port);
+
+  char _host[64];
+  uint16_t _port;
+};
+
+class TcpSink : public NetworkSink
+{
+public:
+  TcpSink (const char *host, const uint16_t port);
+
+  virtual const bool open();
+  virtual void close();
+  virtual const bool isOpen();
+  virtual const int write(const uint8_t *data, const size_t length);
+  virtual const int read(uint8_t *data, const size_t length);
+
+protected:
+  TCPClient _client;
+};
+
+// one datagram per staged batch; no connect cost and no head-of-line blocking, but no delivery guarantee either
+class UdpSink : public NetworkSink
+{
+public:
+  UdpSink (const char *host, const uint16_t port);
+
+  virtual const bool open();
+  virtual void close();
+  virtual const bool isOpen();
+  virtual const int write(const uint8_t *data, const size_t length);
+  virtual const bool datagrams() const { return true; }
+
+protected:
+  UDP _udp;
+  IPAddress _address;
+  bool _open;
+};
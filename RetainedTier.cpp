@@ -0,0 +1,146 @@
+/*
+ * RetainedTier.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include "RetainedTier.h"
+
+// no initializer: it has to keep whatever deep sleep left in it
+retained RetainedTier::Image RetainedTier::_image;
+
+RetainedTier::RetainedTier ()
+ : _count(0)
+ , _read(0)
+ , _cursor(0)
+{
+}
+
+RetainedTier::~RetainedTier ()
+{
+}
+
+const size_t
+RetainedTier::capacity()
+{
+  return sizeof(_image._frame);
+}
+
+const size_t
+RetainedTier::frameOverhead()
+{
+  return WireFormat::headerSize;
+}
+
+const size_t
+RetainedTier::encodedSize(const MotionEntry &entry, const MotionEntry *previous)
+{
+  uint8_t scratch[WireFormat::headerSize + WireFormat::maxEntrySize];
+  WireEncoder encoder;
+
+  // the first entry is encoded against the frame's base, its own second
+  (void) encoder.begin(scratch, 0, previous ? previous->_time : entry._time);
+  if (previous)
+  {
+    (void) encoder.encode(scratch, *previous);
+  }
+
+  return encoder.encode(scratch, entry);
+}
+
+void
+RetainedTier::begin(const uint16_t count, const time_t base)
+{
+  _image._magic = 0;
+  _image._epochFrom = count;
+  _image._length = _encoder.begin(_image._frame, count, base);
+}
+
+const bool
+RetainedTier::append(const MotionEntry &entry)
+{
+  uint8_t encoded[WireFormat::maxEntrySize];
+  size_t size = _encoder.encode(encoded, entry);
+
+  if (_image._length + size > sizeof(_image._frame))
+  {
+    return false;
+  }
+  memcpy(&_image._frame[_image._length], encoded, size);
+  _image._length += size;
+
+  return true;
+}
+
+void
+RetainedTier::seal(const uint16_t epochFrom)
+{
+  _image._epochFrom = epochFrom;
+  _image._crc = checksum();
+  _image._magic = magic;
+}
+
+const uint16_t
+RetainedTier::open()
+{
+  _count = 0;
+  _read = 0;
+  _cursor = 0;
+  _decoder.reset();
+
+  if ((_image._magic != magic) || (_image._length < WireFormat::headerSize) || (_image._length > sizeof(_image._frame)))
+  {
+    return 0;
+  }
+  if (_image._crc != checksum())
+  {
+    Log.warn("retained entries fail their checksum; discarding them");
+    invalidate();
+    return 0;
+  }
+
+  _count = _image._frame[3] | (_image._frame[4] << 8);
+
+  return _count;
+}
+
+const bool
+RetainedTier::next(MotionEntry &entry)
+{
+  while ((_read < _count) && (_cursor < _image._length))
+  {
+    bool decoded;
+    int used = _decoder.next(&_image._frame[_cursor], _image._length - _cursor, entry, decoded);
+
+    if (used <= 0)
+    {
+      break;
+    }
+    _cursor += used;
+    if (decoded)
+    {
+      entry._epochUnknown = (_read++ >= _image._epochFrom);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+RetainedTier::invalidate()
+{
+  _image._magic = 0;
+  _count = 0;
+}
+
+const uint32_t
+RetainedTier::checksum()
+{
+  uint32_t crc = WireFormat::crc32(&_image._length, sizeof(_image._length));
+
+  crc = WireFormat::crc32(&_image._epochFrom, sizeof(_image._epochFrom), crc);
+
+  return WireFormat::crc32(_image._frame, _image._length, crc);
+}
@@ -0,0 +1,70 @@
+/*
+ * RetainedTier.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include "application.h"
+#include "MotionEntry.h"
+#include "WireFormat.h"
+
+// bytes of backup sram the unsent entries get across deep sleep.  the photon and electron give the application
+// 3068 bytes of it and the activity digest, a byte a bucket and a bit a minute, holds 1847 of those, so this and the
+// tier's 12 bytes of header fit with a little to spare; entries are stored as a binary frame, some 8-12 bytes each
+// at the streaming rate
+#ifndef RETAINED_RING_BYTES
+#define RETAINED_RING_BYTES 1152
+#endif
+
+// the newest unsent entries, compacted into retained memory before deep sleep and put back in the ring on wake.
+// one frame of WireFormat entries behind a magic number and a crc, so a cold boot's garbage (or a half-written tier)
+// is never taken for entries.  entries stamped on the unset rtc keep that flag: they are the trailing ones, from
+// _epochFrom on
+class RetainedTier
+{
+public:
+  RetainedTier ();
+  virtual ~RetainedTier ();
+
+  static const size_t capacity();
+  // bytes a frame takes for its header, and 'entry' in it after 'previous' (NULL for the first entry)
+  static const size_t frameOverhead();
+  static const size_t encodedSize(const MotionEntry &entry, const MotionEntry *previous);
+
+  // before sleeping: a frame of 'count' entries, appended in order, then sealed
+  void begin(const uint16_t count, const time_t base);
+  const bool append(const MotionEntry &entry);
+  void seal(const uint16_t epochFrom);
+
+  // on wake: how many entries the tier holds intact (0 if it holds none), then each in turn
+  const uint16_t open();
+  const bool next(MotionEntry &entry);
+  void invalidate();
+
+protected:
+  enum
+  {
+    magic = 0x3152544D	// "MTR1"
+  };
+
+  typedef struct Image
+  {
+    uint32_t _magic;
+    uint32_t _crc;	// over _length, _epochFrom and the frame
+    uint16_t _length;
+    uint16_t _epochFrom;
+    uint8_t _frame[RETAINED_RING_BYTES];
+  } Image;
+
+  static const uint32_t checksum();
+
+  static retained Image _image;
+  WireEncoder _encoder;
+  WireDecoder _decoder;
+  uint16_t _count;
+  uint16_t _read;
+  size_t _cursor;
+};
@@ -0,0 +1,85 @@
+/*
+ * RingBuffer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// single-producer/single-consumer ring; the producer only ever stores _tail and the consumer only ever stores _head,
+// so neither side needs to disable interrupts.  indices run free and are masked on access, which keeps
+// full (tail - head == N) and empty (tail == head) distinguishable without sacrificing a slot.
+// storage is static and N a power of two, so nothing in the isr path allocates or divides
+template <typename Entry, uint32_t N>
+class RingBuffer
+{
+  static_assert((N != 0) && ((N & (N - 1)) == 0), "RingBuffer size must be a power of two");
+
+public:
+  RingBuffer ()
+  : _head(0)
+  , _tail(0)
+  {
+  }
+
+  // producer side
+  const bool push(const Entry &entry)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+    if (tail - _head.load(std::memory_order_acquire) >= N)
+    {
+      return false;
+    }
+    _buffer[tail & _mask] = entry;
+    _tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  // consumer side
+  const uint32_t size() const
+  {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_relaxed);
+  }
+
+  const Entry &peek(const uint32_t which) const
+  {
+    return _buffer[(_head.load(std::memory_order_relaxed) + which) & _mask];
+  }
+
+  void pop(const uint32_t count)
+  {
+    _head.store(_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  // free-running positions, for callers that keep per-slot side data
+  const uint32_t head() const
+  {
+    return _head.load(std::memory_order_relaxed);
+  }
+
+  const uint32_t tail() const
+  {
+    return _tail.load(std::memory_order_relaxed);
+  }
+
+  static const uint32_t capacity()
+  {
+    return N;
+  }
+
+protected:
+  RingBuffer (const RingBuffer &);
+  RingBuffer &operator=(const RingBuffer &);
+
+  static const uint32_t _mask = N - 1;
+
+  Entry _buffer[N];
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _tail;
+};
@@ -0,0 +1,209 @@
+/*
+ * SpiFlash.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include "SpiFlash.h"
+
+#define READ_DATA	0x03
+#define PAGE_PROGRAM	0x02
+#define SECTOR_ERASE	0x20
+#define WRITE_ENABLE	0x06
+#define READ_STATUS	0x05
+#define JEDEC_ID	0x9F
+#define RELEASE_POWER_DOWN	0xAB
+
+#define STATUS_BUSY	0x01
+
+// bytes read per masked transaction
+#define READ_BURST	64
+
+SpiFlash::SpiFlash()
+: _chipSelect(-1)
+{
+}
+
+SpiFlash::~SpiFlash()
+{
+}
+
+const bool
+SpiFlash::begin(const int16_t chipSelectPin)
+{
+  _chipSelect = chipSelectPin;
+  pinMode(_chipSelect, OUTPUT);
+  digitalWrite(_chipSelect, HIGH);
+  SPI.begin();
+  SPI.setDataMode(SPI_MODE0);
+  SPI.setBitOrder(MSBFIRST);
+
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_chipSelect, LOW);
+    SPI.transfer(RELEASE_POWER_DOWN);
+    digitalWrite(_chipSelect, HIGH);
+  }
+  delayMicroseconds(50);
+
+  // a floating bus reads all ones, a missing pull-up all zeroes
+  uint32_t id = jedecId();
+  if ((id == 0) || (id == 0xFFFFFF))
+  {
+    Log.info("no spi flash on chip select %d", _chipSelect);
+    _chipSelect = -1;
+    return false;
+  }
+  Log.info("spi flash %06lx on chip select %d", id, _chipSelect);
+
+  return true;
+}
+
+const uint32_t
+SpiFlash::jedecId() const
+{
+  uint32_t id = 0;
+
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_chipSelect, LOW);
+    SPI.transfer(JEDEC_ID);
+    id = SPI.transfer(0x00) << 16;
+    id |= SPI.transfer(0x00) << 8;
+    id |= SPI.transfer(0x00);
+    digitalWrite(_chipSelect, HIGH);
+  }
+
+  return id;
+}
+
+void
+SpiFlash::read(const uint32_t address, uint8_t *data, size_t length) const
+{
+  uint32_t at = address;
+
+  while (length)
+  {
+    size_t burst = (length < READ_BURST) ? length : READ_BURST;
+
+    ATOMIC_BLOCK()
+    {
+      sendAddress(READ_DATA, at);
+      for (size_t i = 0; i < burst; i++)
+      {
+	data[i] = SPI.transfer(0x00);
+      }
+      digitalWrite(_chipSelect, HIGH);
+    }
+    at += burst;
+    data += burst;
+    length -= burst;
+  }
+}
+
+const bool
+SpiFlash::program(uint32_t address, const uint8_t *data, size_t length)
+{
+  while (length)
+  {
+    // a page program wraps within its page, so never cross the end of one
+    size_t room = pageSize - (address % pageSize);
+    size_t chunk = (length < room) ? length : room;
+
+    writeEnable();
+    ATOMIC_BLOCK()
+    {
+      sendAddress(PAGE_PROGRAM, address);
+      for (size_t i = 0; i < chunk; i++)
+      {
+	SPI.transfer(data[i]);
+      }
+      digitalWrite(_chipSelect, HIGH);
+    }
+    // 3 ms is the W25Q's worst case page program
+    if (!waitReady(5))
+    {
+      Log.error("spi flash program at %06lx timed out", address);
+      return false;
+    }
+    address += chunk;
+    data += chunk;
+    length -= chunk;
+  }
+
+  return true;
+}
+
+const bool
+SpiFlash::eraseSector(const uint32_t address)
+{
+  writeEnable();
+  ATOMIC_BLOCK()
+  {
+    sendAddress(SECTOR_ERASE, address);
+    digitalWrite(_chipSelect, HIGH);
+  }
+
+  // typically 45 ms, 400 ms worst case
+  if (!waitReady(500))
+  {
+    Log.error("spi flash erase at %06lx timed out", address);
+    return false;
+  }
+
+  return true;
+}
+
+void
+SpiFlash::writeEnable() const
+{
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_chipSelect, LOW);
+    SPI.transfer(WRITE_ENABLE);
+    digitalWrite(_chipSelect, HIGH);
+  }
+}
+
+const bool
+SpiFlash::waitReady(const uint32_t timeoutMillis) const
+{
+  uint32_t start = millis();
+
+  for (;;)
+  {
+    uint8_t status;
+    ATOMIC_BLOCK()
+    {
+      digitalWrite(_chipSelect, LOW);
+      SPI.transfer(READ_STATUS);
+      status = SPI.transfer(0x00);
+      digitalWrite(_chipSelect, HIGH);
+    }
+    if (!(status & STATUS_BUSY))
+    {
+      return true;
+    }
+    if (millis() - start > timeoutMillis)
+    {
+      return false;
+    }
+    // an erase is long enough to let loop()'s thread yield
+    if (timeoutMillis > 50)
+    {
+      delay(1);
+    }
+  }
+}
+
+void
+SpiFlash::sendAddress(const uint8_t command, const uint32_t address) const
+{
+  // leaves the chip selected for the data phase
+  digitalWrite(_chipSelect, LOW);
+  SPI.transfer(command);
+  SPI.transfer((address >> 16) & 0xFF);
+  SPI.transfer((address >> 8) & 0xFF);
+  SPI.transfer(address & 0xFF);
+}
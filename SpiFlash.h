@@ -0,0 +1,43 @@
+/*
+ * SpiFlash.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include "application.h"
+
+// a 25-series spi nor flash (winbond W25Q, macronix MX25L and the like) on the accelerometer's bus, with its own chip
+// select.  4 KB sectors erase to 0xFF and programming only clears bits, at most a 256 byte page per command.
+// the LIS331 is read from an isr and a timer, so every transaction here runs with interrupts masked; reads go in
+// short bursts and program/erase completion is polled between transactions, keeping each masked stretch short
+class SpiFlash
+{
+public:
+  enum
+  {
+    pageSize = 256,
+    sectorSize = 4096
+  };
+
+  SpiFlash ();
+  virtual ~SpiFlash ();
+
+  // false if nothing answers on the chip select
+  const bool begin(const int16_t chipSelectPin);
+  const uint32_t jedecId() const;
+
+  void read(const uint32_t address, uint8_t *data, size_t length) const;
+  // programs across page boundaries as needed; false if the part stays busy
+  const bool program(uint32_t address, const uint8_t *data, size_t length);
+  const bool eraseSector(const uint32_t address);
+
+private:
+  void writeEnable() const;
+  const bool waitReady(const uint32_t timeoutMillis) const;
+  void sendAddress(const uint8_t command, const uint32_t address) const;
+
+  int16_t _chipSelect;
+};
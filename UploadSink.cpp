@@ -0,0 +1,46 @@
+/*
+ * UploadSink.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <string.h>
+#include "UploadSink.h"
+
+MemorySink::MemorySink (uint8_t *buffer, const size_t length)
+ : _buffer(buffer)
+ , _length(length)
+ , _used(0)
+ , _bytes(0)
+ , _writes(0)
+{
+}
+
+const int
+MemorySink::write(const uint8_t *data, const size_t length)
+{
+  if (_buffer && _length)
+  {
+    size_t keep = (length < _length) ? length : _length;
+
+    if (_used + keep > _length)
+    {
+      _used = 0;
+    }
+    memcpy(&_buffer[_used], &data[length - keep], keep);
+    _used += keep;
+  }
+  _bytes += length;
+  _writes++;
+
+  return length;
+}
+
+void
+MemorySink::clear()
+{
+  _used = 0;
+  _bytes = 0;
+  _writes = 0;
+}
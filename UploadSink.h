@@ -0,0 +1,56 @@
+/*
+ * UploadSink.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// destination the ring drains into.  each write() is one staged batch of serialized entries.
+// kept free of particle headers so host tools can provide their own sinks
+class UploadSink
+{
+public:
+  UploadSink () {}
+  virtual ~UploadSink () {}
+
+  virtual const bool open() = 0;
+  virtual void close() = 0;
+  virtual const bool isOpen() = 0;
+  // returns bytes accepted, which may be short; negative on error
+  virtual const int write(const uint8_t *data, const size_t length) = 0;
+  // bytes coming back from the receiver (acks); 0 if none pending
+  virtual const int read(uint8_t *data, const size_t length) { return 0; }
+  // datagram sinks deliver each write() on its own, so every write must be independently decodable
+  virtual const bool datagrams() const { return false; }
+  virtual void setEndpoint(const char *host, const uint16_t port) {}
+};
+
+// keeps the most recent bytes written in a caller-supplied buffer and counts everything; for measuring
+// serialization without a network in the way
+class MemorySink : public UploadSink
+{
+public:
+  MemorySink (uint8_t *buffer, const size_t length);
+
+  virtual const bool open() { return true; }
+  virtual void close() {}
+  virtual const bool isOpen() { return true; }
+  virtual const int write(const uint8_t *data, const size_t length);
+
+  const uint32_t bytes() const { return _bytes; }
+  const uint32_t writes() const { return _writes; }
+  const size_t used() const { return _used; }
+  void clear();
+
+protected:
+  uint8_t *_buffer;
+  const size_t _length;
+  size_t _used;
+  uint32_t _bytes;
+  uint32_t _writes;
+};
@@ -0,0 +1,463 @@
+/*
+ * WireFormat.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "WireFormat.h"
+
+const size_t
+WireFormat::putVarint(uint8_t *out, uint32_t value)
+{
+  size_t size = 0;
+
+  while (value >= 0x80)
+  {
+    out[size++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[size++] = value;
+
+  return size;
+}
+
+const size_t
+WireFormat::getVarint(const uint8_t *in, const size_t length, uint32_t &value)
+{
+  value = 0;
+  for (size_t i = 0; (i < length) && (i < 5); i++)
+  {
+    value |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+    if (!(in[i] & 0x80))
+    {
+      return i + 1;
+    }
+  }
+
+  // truncated (or longer than any uint32 encoding)
+  return 0;
+}
+
+const size_t
+WireFormat::putVarint64(uint8_t *out, uint64_t value)
+{
+  size_t size = 0;
+
+  while (value >= 0x80)
+  {
+    out[size++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[size++] = value;
+
+  return size;
+}
+
+const size_t
+WireFormat::getVarint64(const uint8_t *in, const size_t length, uint64_t &value)
+{
+  value = 0;
+  for (size_t i = 0; (i < length) && (i < 10); i++)
+  {
+    value |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+    if (!(in[i] & 0x80))
+    {
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+const int
+WireFormat::formatCsv(char *out, const size_t length, const MotionEntry &entry)
+{
+  struct tm calendar;
+  time_t when = entry._time;
+
+  gmtime_r(&when, &calendar);
+  return snprintf(out, length, "%04d-%02d-%02dT%02d:%02d:%02d.%06uZ,%c,%d,%d,%d\n",
+		  calendar.tm_year + 1900, calendar.tm_mon + 1, calendar.tm_mday,
+		  calendar.tm_hour, calendar.tm_min, calendar.tm_sec, (unsigned int) entry._micros,
+		  entry._mode, entry._x, entry._y, entry._z);
+}
+
+static void
+putUint32(uint8_t *out, const uint32_t value)
+{
+  out[0] = value & 0xFF;
+  out[1] = (value >> 8) & 0xFF;
+  out[2] = (value >> 16) & 0xFF;
+  out[3] = value >> 24;
+}
+
+static uint32_t
+getUint32(const uint8_t *in)
+{
+  return (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+const size_t
+WireFormat::encodeAck(uint8_t *out, const uint32_t sequence)
+{
+  out[0] = magic;
+  out[1] = sequencedVersion;
+  out[2] = ack;
+  putUint32(&out[3], sequence);
+
+  return ackSize;
+}
+
+const int
+WireFormat::decodeAck(const uint8_t *in, const size_t length, uint32_t &sequence)
+{
+  if (length < ackSize)
+  {
+    return 0;
+  }
+  if ((in[0] != magic) || (in[1] != sequencedVersion) || (in[2] != ack))
+  {
+    return -1;
+  }
+  sequence = getUint32(&in[3]);
+
+  return ackSize;
+}
+
+const size_t
+WireFormat::encodeHello(uint8_t *out, const char *device)
+{
+  size_t length = strlen(device);
+
+  length = (length > maxDeviceId) ? maxDeviceId : length;
+  out[0] = magic;
+  out[1] = sequencedVersion;
+  out[2] = hello;
+  out[3] = length;
+  memcpy(&out[4], device, length);
+
+  return 4 + length;
+}
+
+const uint32_t
+WireFormat::crc32(const void *data, const size_t length, uint32_t crc)
+{
+  // bitwise rather than a table: it only checks small blocks, and 1 KB of table is flash better spent
+  const uint8_t *in = (const uint8_t *) data;
+
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= in[i];
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+
+  return ~crc;
+}
+
+static const char *
+parseInt(const char *in, const char *end, long &value)
+{
+  bool negative = (in < end) && (*in == '-');
+  const char *start = in += negative;
+
+  value = 0;
+  while ((in < end) && (*in >= '0') && (*in <= '9'))
+  {
+    value = value * 10 + (*in++ - '0');
+  }
+  value = negative ? -value : value;
+
+  return (in == start) ? NULL : in;
+}
+
+static const char *
+expect(const char *in, const char *end, const char what)
+{
+  return (in && (in < end) && (*in == what)) ? in + 1 : NULL;
+}
+
+const bool
+WireFormat::parseCsv(const char *line, const size_t length, MotionEntry &entry)
+{
+  // 2017-02-12T18:04:05Z,i,-16,32,1008 or 2017-02-12T18:04:05.002500Z,i,-16,32,1008
+  const char *end = line + length;
+  const char *in = line;
+  long year, month, day, hour, minute, second, x, y, z;
+  long zone = 0;
+  long micros = 0;
+
+  if (!(in = parseInt(in, end, year)) || !(in = expect(in, end, '-'))
+      || !(in = parseInt(in, end, month)) || !(in = expect(in, end, '-'))
+      || !(in = parseInt(in, end, day)) || !(in = expect(in, end, 'T'))
+      || !(in = parseInt(in, end, hour)) || !(in = expect(in, end, ':'))
+      || !(in = parseInt(in, end, minute)) || !(in = expect(in, end, ':'))
+      || !(in = parseInt(in, end, second)) || (in >= end))
+  {
+    return false;
+  }
+
+  if (*in == '.')
+  {
+    // digits past the sixth are below what the device measures and are dropped
+    long scale = 100000;
+    const char *start = ++in;
+    while ((in < end) && (*in >= '0') && (*in <= '9'))
+    {
+      micros += (*in++ - '0') * scale;
+      scale /= 10;
+    }
+    if ((in == start) || (in >= end))
+    {
+      return false;
+    }
+  }
+
+  if (*in == 'Z')
+  {
+    in++;
+  }
+  else if ((*in == '+') || (*in == '-'))
+  {
+    long zoneHours, zoneMinutes;
+    int sign = (*in++ == '-') ? -1 : 1;
+    if (!(in = parseInt(in, end, zoneHours)) || !(in = expect(in, end, ':')) || !(in = parseInt(in, end, zoneMinutes)))
+    {
+      return false;
+    }
+    zone = sign * (zoneHours * 3600 + zoneMinutes * 60);
+  }
+
+  if (!(in = expect(in, end, ',')) || (in + 1 >= end) || (in[1] != ','))
+  {
+    return false;
+  }
+  char mode = *in;
+  in += 2;
+  if (!(in = parseInt(in, end, x)) || !(in = expect(in, end, ','))
+      || !(in = parseInt(in, end, y)) || !(in = expect(in, end, ','))
+      || !(in = parseInt(in, end, z)))
+  {
+    return false;
+  }
+  if ((month < 1) || (month > 12) || (day < 1) || (day > 31) || (hour > 23) || (minute > 59) || (second > 60))
+  {
+    return false;
+  }
+
+  // days from civil date, proleptic gregorian
+  long shifted = year - (month <= 2);
+  long era = (shifted >= 0 ? shifted : shifted - 399) / 400;
+  long yearOfEra = shifted - era * 400;
+  long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  long days = era * 146097 + dayOfEra - 719468;
+
+  entry = MotionEntry((time_t) days * 86400 + hour * 3600 + minute * 60 + second - zone, mode, x, y, z, micros);
+
+  return true;
+}
+
+WireEncoder::WireEncoder ()
+ : _previous(0)
+{
+}
+
+const size_t
+WireEncoder::begin(uint8_t *out, const uint16_t count, const time_t base)
+{
+  out[0] = WireFormat::magic;
+  out[1] = WireFormat::microsVersion;
+  out[2] = WireFormat::samples;
+  out[3] = count & 0xFF;
+  out[4] = count >> 8;
+  putUint32(&out[5], (uint32_t) base);
+  _previous = (int64_t) base * 1000000;
+
+  return WireFormat::headerSize;
+}
+
+const size_t
+WireEncoder::begin(uint8_t *out, const uint16_t count, const time_t base, const uint32_t sequence)
+{
+  begin(out, count, base);
+  out[1] = WireFormat::sequencedMicrosVersion;
+  putUint32(&out[WireFormat::headerSize], sequence);
+
+  return WireFormat::sequencedHeaderSize;
+}
+
+const size_t
+WireEncoder::encode(uint8_t *out, const MotionEntry &entry)
+{
+  int64_t when = WireFormat::micros(entry);
+  size_t size = WireFormat::putVarint64(out, WireFormat::zigzag64(when - _previous));
+
+  out[size++] = entry._mode;
+  size += WireFormat::putVarint(&out[size], WireFormat::zigzag(entry._x));
+  size += WireFormat::putVarint(&out[size], WireFormat::zigzag(entry._y));
+  size += WireFormat::putVarint(&out[size], WireFormat::zigzag(entry._z));
+  _previous = when;
+
+  return size;
+}
+
+WireDecoder::WireDecoder ()
+ : _remaining(0)
+ , _sequenced(false)
+ , _done(false)
+ , _hello(false)
+ , _micros(false)
+ , _sequence(0)
+ , _previous(0)
+{
+  _device[0] = '\0';
+}
+
+void
+WireDecoder::reset()
+{
+  _remaining = 0;
+  _sequenced = false;
+  _done = false;
+  _hello = false;
+  _micros = false;
+  _device[0] = '\0';
+  _previous = 0;
+}
+
+const bool
+WireDecoder::sequenced(uint32_t &sequence) const
+{
+  sequence = _sequence;
+  return _sequenced;
+}
+
+const bool
+WireDecoder::frameDone(uint32_t &sequence)
+{
+  bool done = _done;
+
+  sequence = _sequence;
+  _done = false;
+
+  return done;
+}
+
+const uint16_t
+WireDecoder::remaining() const
+{
+  return _remaining;
+}
+
+const bool
+WireDecoder::hello(const char *&device)
+{
+  bool hello = _hello;
+
+  device = _device;
+  _hello = false;
+
+  return hello;
+}
+
+const int
+WireDecoder::next(const uint8_t *in, const size_t length, MotionEntry &entry, bool &decoded)
+{
+  decoded = false;
+
+  if (_remaining == 0)
+  {
+    if ((length >= 4) && (in[0] == WireFormat::magic) && (in[1] == WireFormat::sequencedVersion) && (in[2] == WireFormat::hello))
+    {
+      size_t size = in[3];
+      if (size > WireFormat::maxDeviceId)
+      {
+	return -1;
+      }
+      if (length < 4 + size)
+      {
+	return 0;
+      }
+      memcpy(_device, &in[4], size);
+      _device[size] = '\0';
+      _hello = true;
+
+      return 4 + size;
+    }
+    if (length < WireFormat::headerSize)
+    {
+      return 0;
+    }
+    if ((in[0] != WireFormat::magic) || (in[2] != WireFormat::samples)
+	|| (in[1] < WireFormat::version) || (in[1] > WireFormat::sequencedMicrosVersion))
+    {
+      return -1;
+    }
+
+    size_t size = WireFormat::headerSize;
+    _sequenced = (in[1] == WireFormat::sequencedVersion) || (in[1] == WireFormat::sequencedMicrosVersion);
+    _micros = (in[1] >= WireFormat::microsVersion);
+    if (_sequenced)
+    {
+      if (length < WireFormat::sequencedHeaderSize)
+      {
+	return 0;
+      }
+      _sequence = getUint32(&in[WireFormat::headerSize]);
+      size = WireFormat::sequencedHeaderSize;
+    }
+    _remaining = in[3] | (in[4] << 8);
+    _previous = (int64_t) getUint32(&in[5]) * (_micros ? 1000000 : 1);
+    _done = _sequenced && (_remaining == 0);
+
+    return size;
+  }
+
+  size_t used = 0;
+  size_t size;
+  uint64_t delta;
+  uint32_t x, y, z;
+
+  if ((size = WireFormat::getVarint64(in, length, delta)) == 0)
+  {
+    return (length >= 10) ? -1 : 0;
+  }
+  used += size;
+  if (used >= length)
+  {
+    return 0;
+  }
+  char mode = in[used++];
+  if (((size = WireFormat::getVarint(&in[used], length - used, x)) == 0)
+      || ((used += size) && (size = WireFormat::getVarint(&in[used], length - used, y)) == 0)
+      || ((used += size) && (size = WireFormat::getVarint(&in[used], length - used, z)) == 0))
+  {
+    return (length >= WireFormat::maxEntrySize) ? -1 : 0;
+  }
+  used += size;
+
+  entry = MotionEntry(0, mode, WireFormat::unzigzag(x), WireFormat::unzigzag(y), WireFormat::unzigzag(z));
+  if (_micros)
+  {
+    _previous += WireFormat::unzigzag64(delta);
+    WireFormat::setMicros(entry, _previous);
+  }
+  else
+  {
+    // a 32-bit varint, as old devices sent it
+    _previous += WireFormat::unzigzag((uint32_t) delta);
+    entry._time = (time_t) _previous;
+  }
+  _remaining--;
+  _done = _sequenced && (_remaining == 0);
+  decoded = true;
+
+  return used;
+}
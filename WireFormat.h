@@ -0,0 +1,127 @@
+/*
+ * WireFormat.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "MotionEntry.h"
+
+// compact binary framing for ring uploads; kept free of particle headers so host tools can share it
+//
+// frame header (little-endian):
+//   magic 'M', version, type, count (uint16), base epoch (uint32)
+//   version 2 and 4 frames append a sequence number (uint32) which the receiver acknowledges once the frame is persisted
+// each sample entry:
+//   zigzag varint time delta (vs previous entry, first vs base), mode byte, zigzag varint x, y, z
+//   the delta is in microseconds in version 3 and 4 frames (64-bit varint), whole seconds in version 1 and 2 frames,
+//   which devices no longer send but receivers still accept
+// ack (receiver to device):
+//   magic 'M', version 2, type, sequence (uint32); acknowledges every frame up to and including sequence
+// hello (device to receiver, first thing on a binary session):
+//   magic 'M', version 2, type, length, device id (length bytes, at most 31)
+class WireFormat
+{
+public:
+  enum
+  {
+    magic = 'M',
+    version = 1,
+    sequencedVersion = 2,		// also the version of acks and hellos
+    microsVersion = 3,
+    sequencedMicrosVersion = 4
+  };
+
+  enum frameType
+  {
+    samples = 1,
+    ack = 2,
+    hello = 3
+  };
+
+  static const size_t headerSize = 9;
+  static const size_t sequencedHeaderSize = 13;
+  static const size_t ackSize = 7;
+  static const size_t maxEntrySize = 10 + 1 + 3 * 3;
+  static const size_t maxDeviceId = 31;
+
+  // patches the entry count of a frame whose size was not known when the header was written
+  static inline void setCount(uint8_t *frame, const uint16_t count) { frame[3] = count & 0xFF; frame[4] = count >> 8; }
+  static const size_t encodeAck(uint8_t *out, const uint32_t sequence);
+  // returns bytes consumed (sequence is valid when non-zero), 0 if more input is needed, -1 on corrupt input
+  static const int decodeAck(const uint8_t *in, const size_t length, uint32_t &sequence);
+  static const size_t encodeHello(uint8_t *out, const char *device);
+  // wrap-safe sequence ordering
+  static inline bool sequenceAtOrBefore(const uint32_t a, const uint32_t b) { return (int32_t)(a - b) <= 0; }
+
+  static const size_t putVarint(uint8_t *out, uint32_t value);
+  static const size_t getVarint(const uint8_t *in, const size_t length, uint32_t &value);
+  static const size_t putVarint64(uint8_t *out, uint64_t value);
+  static const size_t getVarint64(const uint8_t *in, const size_t length, uint64_t &value);
+  static inline uint32_t zigzag(const int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+  static inline int32_t unzigzag(const uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+  static inline uint64_t zigzag64(const int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+  static inline int64_t unzigzag64(const uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+  // crc-32 (ieee, as zlib's), continuing from 'crc' so a checksum can span several pieces
+  static const uint32_t crc32(const void *data, const size_t length, uint32_t crc = 0);
+
+  // an entry's timestamp as microseconds since the epoch, and back
+  static inline int64_t micros(const MotionEntry &entry) { return (int64_t) entry._time * 1000000 + entry._micros; }
+  static inline void setMicros(MotionEntry &entry, const int64_t micros)
+  {
+    entry._time = (time_t) (micros / 1000000);
+    entry._micros = (uint32_t) (micros % 1000000);
+  }
+
+  // renders an entry the same way the csv upload mode does, e.g. 2017-02-12T18:04:05.002500Z,i,-16,32,1008
+  static const int formatCsv(char *out, const size_t length, const MotionEntry &);
+  // the reverse, without allocating; accepts the Z and +hh:mm zone forms, with or without fractional seconds (to
+  // the microsecond).  false if the line is malformed
+  static const bool parseCsv(const char *line, const size_t length, MotionEntry &);
+};
+
+class WireEncoder
+{
+public:
+  WireEncoder ();
+
+  const size_t begin(uint8_t *out, const uint16_t count, const time_t base);
+  const size_t begin(uint8_t *out, const uint16_t count, const time_t base, const uint32_t sequence);
+  const size_t encode(uint8_t *out, const MotionEntry &);
+
+protected:
+  int64_t _previous;	// microseconds
+};
+
+class WireDecoder
+{
+public:
+  WireDecoder ();
+
+  // decodes the next entry from the stream, skipping over frame headers
+  // returns bytes consumed (entry is valid only when 'decoded' is set), 0 if more input is needed, -1 on corrupt input
+  const int next(const uint8_t *in, const size_t length, MotionEntry &entry, bool &decoded);
+  void reset();
+  // entries still expected from the current frame; 0 at a frame boundary
+  const uint16_t remaining() const;
+  // sequence of the frame being decoded, if it carries one
+  const bool sequenced(uint32_t &sequence) const;
+  // true once, after the last entry of a sequenced frame has been decoded
+  const bool frameDone(uint32_t &sequence);
+  // true once, after a hello frame has been decoded
+  const bool hello(const char *&device);
+
+protected:
+  uint16_t _remaining;
+  bool _sequenced;
+  bool _done;
+  bool _hello;
+  bool _micros;
+  uint32_t _sequence;
+  char _device[WireFormat::maxDeviceId + 1];
+  int64_t _previous;	// microseconds in micros frames, seconds otherwise
+};
@@ -7,7 +7,7 @@ STARTUP(System.enableFeature(FEATURE_RETAINED_MEMORY));
 
 SerialLogHandler logHandler(LOG_LEVEL_INFO);
 //SerialLogHandler logHandler(LOG_LEVEL_TRACE);
-MotionTracker tracker(512, A1);	// use D1 or A1 (for all same side board connections).  using A0 conflicts with on-board LED; D0 conflicts as well
+MotionTracker tracker(A1);	// ring capacity is NETWORK_RING_ENTRIES; use D1 or A1 (for all same side board connections).  using A0 conflicts with on-board LED; D0 conflicts as well
 bool savePower = false;
 
 void
@@ -29,12 +29,14 @@ lowPowerMode()
 void
 maybeSetRTC()
 {
-  // reset RTC if in low power mode and haven't connected to Particle yet
+  // in low power mode the radio stays off after a cold boot: until the RTC is set samples are stamped on its count
+  // since power-up and flagged, and held back until MotionClock can shift them onto the epoch (unsetToEpoch), so
+  // only once a hunk is ready to upload is it worth connecting to set it
   if (savePower)
   {
-    if (!Particle.connected() && (Time.year() == 1970))
+    if (!Particle.connected() && (Time.year() == 1970) && tracker._ring.awaitingEpoch())
     {
-      Log.info("RTC not set; connecting up to set it");
+      Log.info("RTC not set and uploads are waiting on it; connecting up to set it");
       Particle.connect();
     }
 
@@ -0,0 +1,164 @@
+/*
+ * ColumnStore.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "MotionEntry.h"
+
+// chunked columnar layout for ingested motion data, meant to be mmap'd and scanned in place
+//
+//   chunk*  index  footer
+//
+// each chunk holds up to rowsPerChunk rows as six bit-packed columns, each frame-of-reference encoded against
+// the column minimum: time (seconds), mode (0 unknown, 1 'i', 2 's'), x, y, z and micros (within the second).  time
+// is delta encoded first, each row less the one before (the first row less the chunk's _minTime), so a stream a
+// sample a second packs at a bit or two a row; the column minimum takes care of time stepping back.  the index has
+// one ChunkInfo per chunk, with the time bounds used to skip chunks outside a query.  the footer sits at the very
+// end of the file
+class ColumnStore
+{
+public:
+  static const uint32_t magic = 0x43564F4D;	// "MOVC"
+  static const uint32_t version = 3;
+  static const uint32_t rowsPerChunk = 65536;
+
+  enum column
+  {
+    timeColumn = 0,
+    modeColumn,
+    xColumn,
+    yColumn,
+    zColumn,
+    microsColumn,
+    columns
+  };
+
+  typedef struct ColumnInfo
+  {
+    int64_t _base;	// value subtracted before packing (for time, the smallest delta)
+    uint64_t _offset;	// from the start of the file, 8-byte aligned
+    uint32_t _width;	// bits per value, 0 when every value equals _base
+    uint32_t _reserved;
+  } ColumnInfo;
+
+  typedef struct ChunkInfo
+  {
+    int64_t _minTime;
+    int64_t _maxTime;
+    uint32_t _rows;
+    uint32_t _interrupts;
+    ColumnInfo _column[columns];
+  } ChunkInfo;
+
+  typedef struct Footer
+  {
+    uint64_t _indexOffset;
+    uint32_t _chunks;
+    uint32_t _version;
+    uint64_t _rows;
+    uint32_t _reserved;
+    uint32_t _magic;
+  } Footer;
+
+  static const uint8_t modeCode(const char mode)
+  {
+    return (mode == 'i') ? 1 : (mode == 's') ? 2 : 0;
+  }
+
+  static const char modeChar(const uint8_t code)
+  {
+    return (code == 1) ? 'i' : (code == 2) ? 's' : 'x';
+  }
+
+  static const uint32_t widthFor(const uint64_t range)
+  {
+    uint32_t width = 0;
+    while ((width < 64) && (range >> width))
+    {
+      width++;
+    }
+    return width;
+  }
+
+  // appends values - base packed at width bits, padded to whole 64-bit words
+  static void pack(std::vector<uint64_t> &out, const int64_t *values, const uint32_t count, const int64_t base, const uint32_t width)
+  {
+    if (!width)
+    {
+      return;
+    }
+
+    uint64_t word = 0;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      uint64_t value = (uint64_t) (values[i] - base);
+      word |= value << used;
+      used += width;
+      if (used >= 64)
+      {
+	out.push_back(word);
+	used -= 64;
+	word = used ? (value >> (width - used)) : 0;
+      }
+    }
+    if (used)
+    {
+      out.push_back(word);
+    }
+  }
+
+  // the time column's deltas, first from 'origin'
+  static void deltas(int64_t *out, const int64_t *values, const uint32_t count, const int64_t origin)
+  {
+    int64_t previous = origin;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      out[i] = values[i] - previous;
+      previous = values[i];
+    }
+  }
+
+  // the inverse, in place: unpacked deltas back to times relative to the origin
+  static void integrate(int32_t *values, const uint32_t count)
+  {
+    for (uint32_t i = 1; i < count; i++)
+    {
+      values[i] += values[i - 1];
+    }
+  }
+
+  // the inverse of pack(); words must hold count values at width bits
+  static void unpack(int32_t *out, const uint64_t *words, const uint32_t count, const int64_t base, const uint32_t width)
+  {
+    if (!width)
+    {
+      for (uint32_t i = 0; i < count; i++)
+      {
+	out[i] = (int32_t) base;
+      }
+      return;
+    }
+
+    const uint64_t mask = (width == 64) ? ~0ULL : ((1ULL << width) - 1);
+    uint64_t bit = 0;
+    for (uint32_t i = 0; i < count; i++, bit += width)
+    {
+      uint64_t word = bit >> 6;
+      uint32_t shift = bit & 63;
+      uint64_t value = words[word] >> shift;
+      if (shift + width > 64)
+      {
+	value |= words[word + 1] << (64 - shift);
+      }
+      out[i] = (int32_t) ((int64_t) (value & mask) + base);
+    }
+  }
+};
@@ -0,0 +1,60 @@
+/*
+ * FileSink.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include "UploadSink.h"
+
+// host-side sink appending everything written to a file, e.g. to capture a stream for motiondecode or to time
+// serialization with the disk as the only other cost
+class FileSink : public UploadSink
+{
+public:
+  FileSink (const char *path)
+  : _path(path)
+  , _file(NULL)
+  {
+  }
+
+  virtual ~FileSink ()
+  {
+    close();
+  }
+
+  virtual const bool open()
+  {
+    if (!_file)
+    {
+      _file = fopen(_path, "ab");
+    }
+    return _file != NULL;
+  }
+
+  virtual void close()
+  {
+    if (_file)
+    {
+      fclose(_file);
+      _file = NULL;
+    }
+  }
+
+  virtual const bool isOpen()
+  {
+    return _file != NULL;
+  }
+
+  virtual const int write(const uint8_t *data, const size_t length)
+  {
+    return fwrite(data, 1, length, _file);
+  }
+
+protected:
+  const char *_path;
+  FILE *_file;
+};
@@ -0,0 +1,83 @@
+/*
+ * Trace.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// accelerometer activity as the firmware sees it, for replaying through the handlers.  text, one event per line:
+//
+//   # epoch 1486922645
+//   <microseconds since the epoch line> <i|s> <x> <y> <z>
+//
+// 'i' is a motion interrupt (MotionTracker::motionDetected), 's' a streaming timer poll (MotionTracker::sampleStream);
+// x, y and z are the raw register values the handler reads back.  events are in time order
+typedef struct TraceEvent
+{
+  uint64_t _micros;
+  char _kind;
+  int16_t _x;
+  int16_t _y;
+  int16_t _z;
+} TraceEvent;
+
+class Trace
+{
+public:
+  static void writeHeader(FILE *out, const time_t epoch)
+  {
+    fprintf(out, "# epoch %ld\n", (long) epoch);
+  }
+
+  static void write(FILE *out, const TraceEvent &event)
+  {
+    fprintf(out, "%" PRIu64 " %c %d %d %d\n", event._micros, event._kind, event._x, event._y, event._z);
+  }
+
+  // false on a malformed line or events out of order
+  static const bool read(FILE *in, std::vector<TraceEvent> &events, time_t &epoch)
+  {
+    char line[128];
+    unsigned int number = 0;
+
+    epoch = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+      long when;
+      int x, y, z;
+      TraceEvent event;
+
+      number++;
+      if (line[0] == '#')
+      {
+	if (sscanf(line, "# epoch %ld", &when) == 1)
+	{
+	  epoch = when;
+	}
+	continue;
+      }
+      if ((sscanf(line, "%" SCNu64 " %c %d %d %d", &event._micros, &event._kind, &x, &y, &z) != 5)
+	  || ((event._kind != 'i') && (event._kind != 's'))
+	  || (!events.empty() && (event._micros < events.back()._micros)))
+      {
+	fprintf(stderr, "trace line %u: %s", number, line);
+	return false;
+      }
+      event._x = x;
+      event._y = y;
+      event._z = z;
+      events.push_back(event);
+    }
+
+    return true;
+  }
+};
@@ -0,0 +1,364 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * micro-benchmarks for the pipeline's hot paths, built from the firmware objects on the simulated runtime:
+ *
+ *   fill             NetworkRingBuffer::fill() with the ring empty, half full, nearly full and full (the drop path)
+ *   empty/<format>   NetworkRingBuffer::empty(128) into a memory sink, per entry, at several backlogs
+ *   serialize/...    one entry as the ring renders it: csv (Time.format + sprintf) or binary; plus
+ *                    WireFormat::formatCsv for comparison
+ *   registerActivity ActivityDigest::registerActivity()
+ *   publishBacklog   ActivityDigest::registerActivity(), publishBacklog(240) and publish() until done: finding and
+ *                    publishing the one minute that changed
+ *
+ * each is timed in batches until it has run for the minimum time, five times over, and the median is reported as
+ * json on stdout: ns/op, bytes/op (bytes produced: serialized, uploaded or published) and allocs/op (calls to
+ * operator new).  the clock is virtual, so waiting on the publish rate limit costs nothing and Time is fixed
+ *
+ *   make -C host bench
+ *   host/build/bench [-t min ms] [-f name filter] > bench.json
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "ActivityDigest.h"
+#include "NetworkRingBuffer.h"
+#include "Simulation.h"
+
+static std::atomic<uint64_t> allocations(0);
+
+void *
+operator new(size_t size)
+{
+  allocations++;
+  void *memory = malloc(size ? size : 1);
+  if (!memory)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *
+operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void
+operator delete(void *memory) noexcept
+{
+  free(memory);
+}
+
+void
+operator delete[](void *memory) noexcept
+{
+  free(memory);
+}
+
+// measures only between start() and stop(), so a body can reset state untimed
+class Timing
+{
+public:
+  Timing() : _nanos(0), _allocations(0), _bytes(0) {}
+
+  void start()
+  {
+    _allocationsAtStart = allocations;
+    _started = std::chrono::steady_clock::now();
+  }
+
+  void stop()
+  {
+    _nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _started).count();
+    _allocations += allocations - _allocationsAtStart;
+  }
+
+  uint64_t _nanos;
+  uint64_t _allocations;
+  uint64_t _bytes;
+
+private:
+  std::chrono::steady_clock::time_point _started;
+  uint64_t _allocationsAtStart;
+};
+
+// runs 'operations' operations, timing them with 'timing' and adding the bytes they produced
+typedef std::function<void(Timing &timing, const uint64_t operations)> Body;
+
+typedef struct Result
+{
+  std::string _name;
+  std::string _parameters;	// json object members
+  std::string _unit;		// what one op is
+  uint64_t _operations;
+  double _nanos;
+  double _bytes;
+  double _allocations;
+} Result;
+
+static std::vector<Result> results;
+static double minimumMillis = 200;
+static const char *filter = "";
+
+// exposes the ring's serializer
+class BenchRing : public NetworkRingBuffer
+{
+public:
+  BenchRing(UploadSink *sink) : NetworkRingBuffer(sink) {}
+
+  using NetworkRingBuffer::serialize;
+
+  // back to exactly 'level' unsent entries, sending the surplus or topping up
+  void refill(const uint32_t level, const MotionEntry &entry)
+  {
+    while ((uint32_t) spaceLeft() > level)
+    {
+      empty(spaceLeft() - level);
+    }
+    // blocks of the packed ring can leave it full short of its nominal size
+    while (((uint32_t) spaceLeft() < level) && fill(entry))
+    {
+    }
+  }
+};
+
+static void
+run(const char *name, const std::string &parameters, const char *unit, Body body)
+{
+  std::string full = std::string(name) + " " + parameters;
+  if (!strstr(full.c_str(), filter))
+  {
+    return;
+  }
+
+  // grow the batch until it runs long enough to time, then take the median of five batches
+  uint64_t operations = 1;
+  for (;;)
+  {
+    Timing timing;
+    body(timing, operations);
+    if ((timing._nanos >= minimumMillis * 1e6 / 5) || (operations >= (1ULL << 34)))
+    {
+      break;
+    }
+    operations *= (timing._nanos < 1e6) ? 10 : 2;
+  }
+
+  Timing runs[5];
+  for (size_t i = 0; i < 5; i++)
+  {
+    body(runs[i], operations);
+  }
+  std::sort(runs, runs + 5, [](const Timing &a, const Timing &b) { return a._nanos < b._nanos; });
+
+  const Timing &median = runs[2];
+  Result result = { name, parameters, unit, operations, (double) median._nanos / operations, (double) median._bytes / operations,
+		    (double) median._allocations / operations };
+  results.push_back(result);
+  fprintf(stderr, "%-18s %-28s %10.1f ns/%s %8.1f bytes %6.2f allocs\n", name, parameters.c_str(), result._nanos, unit, result._bytes, result._allocations);
+}
+
+static void
+benchFill(const MotionEntry &entry)
+{
+  static uint8_t keep[64];
+  MemorySink sink(keep, sizeof(keep));
+  BenchRing ring(&sink);
+  ring.setFormat(NetworkRingBuffer::binary);
+  ring.refill(NETWORK_RING_ENTRIES, entry);
+
+  const uint32_t full = ring.spaceLeft();
+  const uint32_t levels[] = { 0, full / 2, full - 64, full };
+
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+  {
+    uint32_t level = levels[i];
+    char parameters[64];
+    snprintf(parameters, sizeof(parameters), "\"level\": %u", level);
+
+    run("fill", parameters, "entry", [&](Timing &timing, const uint64_t operations)
+    {
+      // 32 at a time from the given level, so the level barely moves while timed (a full ring stays full)
+      for (uint64_t done = 0; done < operations; )
+      {
+	uint64_t batch = std::min<uint64_t>(32, operations - done);
+	ring.refill(level, entry);
+	timing.start();
+	for (uint64_t j = 0; j < batch; j++)
+	{
+	  ring.fill(entry);
+	}
+	timing.stop();
+	done += batch;
+      }
+    });
+  }
+}
+
+static void
+benchEmpty(const MotionEntry &entry, const NetworkRingBuffer::format format, const char *name)
+{
+  static uint8_t keep[64];
+  MemorySink sink(keep, sizeof(keep));
+  BenchRing ring(&sink);
+  const uint32_t hunk = 128;
+  const uint32_t levels[] = { hunk, NETWORK_RING_ENTRIES / 2, NETWORK_RING_ENTRIES };
+
+  ring.setFormat(format);
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+  {
+    uint32_t level = levels[i];
+    char parameters[64];
+    snprintf(parameters, sizeof(parameters), "\"level\": %u, \"hunk\": %u", level, hunk);
+
+    run(name, parameters, "entry", [&](Timing &timing, const uint64_t operations)
+    {
+      for (uint64_t done = 0; done < operations; )
+      {
+	ring.refill(level, entry);
+	uint32_t bytes = sink.bytes();
+	timing.start();
+	int16_t sent = ring.empty(hunk);
+	timing.stop();
+	timing._bytes += sink.bytes() - bytes;
+	done += (sent > 0) ? sent : 1;
+      }
+    });
+  }
+}
+
+static void
+benchSerialize(const MotionEntry &entry)
+{
+  static uint8_t keep[64];
+  MemorySink sink(keep, sizeof(keep));
+  BenchRing ring(&sink);
+  char line[128];
+
+  ring.setFormat(NetworkRingBuffer::csv);
+  run("serialize/csv", "\"via\": \"Time.format+sprintf\"", "entry", [&](Timing &timing, const uint64_t operations)
+  {
+    timing.start();
+    for (uint64_t i = 0; i < operations; i++)
+    {
+      timing._bytes += ring.serialize(entry);
+    }
+    timing.stop();
+  });
+
+  run("serialize/csv", "\"via\": \"WireFormat::formatCsv\"", "entry", [&](Timing &timing, const uint64_t operations)
+  {
+    timing.start();
+    for (uint64_t i = 0; i < operations; i++)
+    {
+      timing._bytes += WireFormat::formatCsv(line, sizeof(line), entry);
+    }
+    timing.stop();
+  });
+
+  BenchRing binary(&sink);
+  binary.setFormat(NetworkRingBuffer::binary);
+  run("serialize/binary", "\"via\": \"WireEncoder\"", "entry", [&](Timing &timing, const uint64_t operations)
+  {
+    timing.start();
+    for (uint64_t i = 0; i < operations; i++)
+    {
+      timing._bytes += binary.serialize(entry);
+    }
+    timing.stop();
+  });
+}
+
+static void
+benchDigest(const MotionEntry &entry)
+{
+  ActivityDigest digest;
+  uint64_t published = 0;
+
+  run("registerActivity", "", "call", [&](Timing &timing, const uint64_t operations)
+  {
+    timing.start();
+    for (uint64_t i = 0; i < operations; i++)
+    {
+      digest.registerActivity(entry);
+    }
+    timing.stop();
+  });
+
+  Particle.connect();
+  Simulation::onPublish([&](const char *name, const char *data)
+  {
+    published += strlen(data);
+    return true;
+  });
+  // the next minute: the registerActivity run has long since saturated this one, so counting more in it changes nothing
+  MotionEntry next(entry);
+  next._time += 60;
+  run("publishBacklog", "\"changed\": 1", "call", [&](Timing &timing, const uint64_t operations)
+  {
+    published = 0;
+    timing.start();
+    for (uint64_t i = 0; i < operations; i++)
+    {
+      digest.registerActivity(next);
+      digest.publishBacklog(240);
+      while (digest.publish())
+      {
+	delay(DIGEST_PUBLISH_PERIOD);
+      }
+    }
+    timing.stop();
+    timing._bytes += published;
+  });
+}
+
+int
+main(int argc, char *argv[])
+{
+  int option;
+
+  while ((option = getopt(argc, argv, "t:f:")) != -1)
+  {
+    switch (option)
+    {
+      case 't': minimumMillis = atof(optarg); break;
+      case 'f': filter = optarg; break;
+      default:
+	fprintf(stderr, "usage: %s [-t min ms] [-f name filter]\n", argv[0]);
+	return 1;
+    }
+  }
+
+  Log._level = LOG_LEVEL_NONE;
+  Simulation::useVirtualClock(NULL);
+  Time.setTime(1486922645);
+
+  MotionEntry entry(Time.now(), 's', -1232, 2048, 16368);
+  benchFill(entry);
+  benchEmpty(entry, NetworkRingBuffer::csv, "empty/csv");
+  benchEmpty(entry, NetworkRingBuffer::binary, "empty/binary");
+  benchSerialize(entry);
+  benchDigest(entry);
+
+  printf("{\n  \"ring_entries\": %u,\n  \"compiler\": \"%s\",\n  \"min_time_ms\": %.0f,\n  \"benchmarks\": [\n", NETWORK_RING_ENTRIES, __VERSION__, minimumMillis);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result &result = results[i];
+    printf("    { \"name\": \"%s\", \"parameters\": { %s }, \"op\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"bytes_per_op\": %.2f, \"allocs_per_op\": %.3f }%s\n",
+	   result._name.c_str(), result._parameters.c_str(), result._unit.c_str(), (unsigned long long) result._operations, result._nanos, result._bytes, result._allocations,
+	   (i + 1 < results.size()) ? "," : "");
+  }
+  printf("  ]\n}\n");
+
+  return 0;
+}
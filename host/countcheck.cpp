@@ -0,0 +1,154 @@
+/*
+ * countcheck.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * checks the digest's byte counts against their error bounds: every count from 0 to LogCount::maximum encoded and
+ * decoded (exact below 32, within 1/32 above), codes in order and stable, merges of random pairs within two
+ * roundings of the true sum, and a DigestTier fed random minutes over several days against exact range sums, then
+ * rebuilt over the same codes as after a wake.  reports the worst error seen of each; non-zero exit if any is out
+ * of bounds
+ *
+ *   make -C host countcheck
+ *   host/build/countcheck [days] [seed]
+ */
+
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "DigestTier.h"
+#include "LogCount.h"
+
+static const double
+relative(const double got, const double want)
+{
+  return want ? ((got > want) ? got - want : want - got) / want : got;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const unsigned int days = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10;
+  std::mt19937 random((argc > 2) ? strtoul(argv[2], NULL, 0) : 1);
+  unsigned int failures = 0;
+
+  // every count: exact below 32, then within 1/32, and never coded below a smaller count
+  double worst = 0;
+  uint8_t previous = 0;
+  for (uint32_t count = 0; count <= LogCount::maximum; count++)
+  {
+    uint8_t code = LogCount::encode(count);
+    uint32_t decoded = LogCount::decode(code);
+    double error = relative(decoded, count);
+
+    worst = (error > worst) ? error : worst;
+    if (((count < LogCount::exact) && (decoded != count)) || (error > 1.0 / 32) || (code < previous))
+    {
+      if (failures++ < 10)
+      {
+	printf("count %u: code %u decodes to %u\n", count, code, decoded);
+      }
+    }
+    previous = code;
+  }
+  printf("encode: worst error %.4f%% (bound %.4f%%)\n", 100 * worst, 100.0 / 32);
+
+  // every code the encoder makes decodes to a count that encodes back to it
+  for (unsigned int code = 0; code < 256; code++)
+  {
+    if (LogCount::encode(LogCount::decode(code)) != code)
+    {
+      printf("code %u does not survive a round trip\n", code);
+      failures++;
+    }
+  }
+  printf("round trip: all 256 codes\n");
+
+  // a merge rounds twice: once for each side, once for their sum
+  worst = 0;
+  for (int i = 0; i < 1000000; i++)
+  {
+    uint32_t a = random() % (LogCount::maximum / 2);
+    uint32_t b = random() % ((i & 1) ? 100 : LogCount::maximum / 2);
+    double error = relative(LogCount::decode(LogCount::merge(LogCount::encode(a), LogCount::encode(b))), a + b);
+    worst = (error > worst) ? error : worst;
+    if (error > 2.0 / 32 + 1.0 / 1024)
+    {
+      if (failures++ < 10)
+      {
+	printf("merge %u + %u off by %.4f%%\n", a, b, 100 * error);
+      }
+    }
+  }
+  printf("merge: worst error %.4f%% (bound %.4f%%)\n", 100 * worst, 100 * (2.0 / 32 + 1.0 / 1024));
+
+  // a minute tier fed in time order, bursts and quiet: its sums are within 1/32 of the truth, and the newest minute
+  // is exact
+  static uint8_t codeStore[60 * 24];
+  DigestHead head = { -1, 0 };
+  DigestTier<60 * 24> tier(codeStore, head, 60);
+  std::vector<uint32_t> truth(days * 60 * 24);
+  const time_t start = 1486857600;
+
+  tier.begin();
+  for (uint32_t minute = 0; minute < truth.size(); minute++)
+  {
+    uint32_t burst = (random() % 4) ? random() % 8 : random() % 2000;
+    for (uint32_t n = 0; n < burst; n++)
+    {
+      (void) tier.add(start + minute * 60 + random() % 60, 1);
+    }
+    truth[minute] = burst;
+  }
+
+  worst = 0;
+  const int32_t last = tier.newest();
+  for (int i = 0; i < 100000; i++)
+  {
+    int32_t to = last + 1 - random() % (60 * 24);
+    int32_t from = to - 1 - random() % (to - tier.oldest());
+    double want = 0;
+    for (int32_t m = from; m < to; m++)
+    {
+      want += truth[m - start / 60];
+    }
+    double error = relative(tier.sum(from, to), want);
+    worst = (error > worst) ? error : worst;
+    if (error > 1.0 / 32)
+    {
+      if (failures++ < 10)
+      {
+	printf("tier sum of minutes [%d, %d) is %u, not %.0f\n", from, to, tier.sum(from, to), want);
+      }
+    }
+  }
+  if (tier.count(last) != truth[last - start / 60])
+  {
+    printf("newest minute counts %u, not %u\n", tier.count(last), truth[last - start / 60]);
+    failures++;
+  }
+  printf("tier: %u days, worst range sum error %.4f%% (bound %.4f%%)\n", days, 100 * worst, 100.0 / 32);
+
+  // after a wake the codes and head are intact and only the index is rebuilt; it answers as the one built up did
+  DigestTier<60 * 24> woken(codeStore, head, 60);
+  woken.begin();
+  unsigned int differ = 0;
+  for (int i = 0; i < 100000; i++)
+  {
+    int32_t to = last + 1 - random() % (60 * 24);
+    int32_t from = to - 1 - random() % (to - tier.oldest());
+    differ += (woken.sum(from, to) != tier.sum(from, to));
+  }
+  if (differ)
+  {
+    printf("rebuilt tier differs on %u range sums\n", differ);
+    failures++;
+  }
+  printf("rebuild: %s\n", differ ? "differs" : "same sums");
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+
+  return failures ? 1 : 0;
+}
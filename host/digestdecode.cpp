@@ -0,0 +1,137 @@
+/*
+ * digestdecode.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * host-side decoder for activity digest publishes: takes their data a line at a time, as the cloud passes it on or
+ * as moovit prints it ("publish activity <data>"), checks each message and folds its minutes into minute-of-day
+ * slots, a later message's minute replacing an earlier one's (a sparse message only replaces the minutes it
+ * gives).  reads the packed messages (DigestFormat), dense and sparse, and the older "offset:count,count,..." ones
+ * alike, and prints the slots like ActivityDigest::dump() and motionquery -d,
+ * so the three can be compared
+ *
+ *   make -C host digestdecode
+ *   host/build/moovit ... | host/build/digestdecode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DigestFormat.h"
+
+static const int
+decodeText(const char *data, uint16_t &first, uint16_t *counts, bool *given)
+{
+  char *end;
+  unsigned long offset = strtoul(data, &end, 10);
+
+  if ((end == data) || (*end != ':') || (offset >= DigestFormat::minutesPerDay))
+  {
+    return -1;
+  }
+  first = offset;
+
+  int minutes = 0;
+  for (const char *at = end + 1; minutes < (int) DigestFormat::minutesPerDay; at = end + 1)
+  {
+    given[minutes] = true;
+    counts[minutes++] = strtoul(at, &end, 10);
+    if ((end == at) || (*end != ','))
+    {
+      return ((end != at) && (*end == '\0')) ? minutes : -1;
+    }
+  }
+
+  return -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  FILE *in = stdin;
+
+  if ((argc > 1) && !(in = fopen(argv[1], "r")))
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  static uint16_t slots[DigestFormat::minutesPerDay];
+  uint16_t counts[DigestFormat::minutesPerDay];
+  bool given[DigestFormat::minutesPerDay];
+  uint8_t packed[1024];
+  char line[2048];
+  unsigned int messages = 0;
+  unsigned int damaged = 0;
+  unsigned long minutes = 0;
+  unsigned int sparse = 0;
+  unsigned long characters = 0;
+
+  while (fgets(line, sizeof(line), in))
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+
+    // moovit's console line, or the data alone
+    char *data = line;
+    if (!strncmp(line, "publish ", 8))
+    {
+      if (strncmp(line + 8, "activity ", 9))
+      {
+	continue;
+      }
+      data = line + 17;
+      if (char *note = strstr(data, " ("))
+      {
+	*note = '\0';
+      }
+    }
+    if (!*data)
+    {
+      continue;
+    }
+
+    uint16_t first = 0;
+    int covered;
+    if (strchr(data, ':'))
+    {
+      covered = decodeText(data, first, counts, given);
+    }
+    else
+    {
+      int length = DigestFormat::fromBase64(packed, sizeof(packed), data, strlen(data));
+      covered = (length < 0) ? -1 : DigestFormat::decode(packed, length, first, counts, given);
+      sparse += (covered >= 0) && (packed[0] == DigestFormat::sparse);
+    }
+    if (covered < 0)
+    {
+      fprintf(stderr, "damaged message: %s\n", data);
+      damaged++;
+      continue;
+    }
+
+    for (int i = 0; i < covered; i++)
+    {
+      if (given[i])
+      {
+	slots[(first + i) % DigestFormat::minutesPerDay] = counts[i];
+	minutes++;
+      }
+    }
+    messages++;
+    characters += strlen(data);
+  }
+
+  printf("Digest info:\n");
+  for (unsigned int i = 0; i < DigestFormat::minutesPerDay; i++)
+  {
+    if (slots[i])
+    {
+      printf("slot[%u] = %u\n", i, slots[i]);
+    }
+  }
+  fprintf(stderr, "%u messages (%u sparse, %u damaged), %lu minutes in %lu characters (%.2f a minute)\n", messages,
+	  sparse, damaged, minutes, characters, minutes ? (double) characters / minutes : 0.0);
+
+  return damaged ? 1 : 0;
+}
@@ -0,0 +1,465 @@
+/*
+ * flashstress.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * power loss test of the flash log (FlashLog over SpiFlash, on a simulated part in a file): appends and consumes
+ * records at random, cutting the power at a random byte of some program or erase in every run, then boots the log
+ * again and checks what it recovered.  that must be every record whose append completed before the cut, less those
+ * whose consumption completed, in order and intact; only the append or consumption under way at the cut may have
+ * gone either way.  the log is kept small so runs wrap it, fill it and reuse sectors; at the end the erase counts
+ * per sector show how evenly it wears the part.
+ *
+ * then entries stamped on the unset rtc, through the ring and its clock on a part of their own: spilled before the rtc
+ * is set and the device reset, they must be dropped by a boot that finds the rtc already set (it cannot know the
+ * shift onto the epoch), and delivered on the epoch after a reset if a boot that saw the rtc unset learnt it first.
+ * last the dating of such records, with the power cut at each byte of it in turn: no record may read on a torn shift
+ *
+ *   make -C host flashstress
+ *   host/build/flashstress [-n power cuts] [-s sectors] [-r seed] [-v] [flash file]
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <deque>
+#include <random>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "FlashLog.h"
+#include "MotionClock.h"
+#include "NetworkRingBuffer.h"
+#include "Simulation.h"
+#include "SpiFlashSim.h"
+
+static const uint16_t chipSelect = D5;
+static const uint16_t epochChipSelect = D6;
+static const time_t epoch = 1486922645;
+
+// the link: down, or up taking csv and noting what arrives
+class CollectSink : public UploadSink
+{
+public:
+  CollectSink(const bool up) : _up(up), _entries(0), _earliest(0), _latest(0) {}
+
+  virtual const bool open() { return _up; }
+  virtual void close() {}
+  virtual const bool isOpen() { return _up; }
+  virtual const int write(const uint8_t *data, const size_t length)
+  {
+    // the ring writes whole lines
+    for (const char *line = (const char *) data, *end; line < (const char *) data + length; line = end + 1)
+    {
+      MotionEntry entry;
+      end = (const char *) memchr(line, '\n', (const char *) data + length - line);
+      end = end ? end : (const char *) data + length;
+      if (WireFormat::parseCsv(line, end - line, entry))
+      {
+	_earliest = (!_entries || (entry._time < _earliest)) ? entry._time : _earliest;
+	_latest = (!_entries || (entry._time > _latest)) ? entry._time : _latest;
+	_entries++;
+      }
+    }
+    return length;
+  }
+
+  bool _up;
+  uint32_t _entries;
+  time_t _earliest;
+  time_t _latest;
+};
+
+// one boot of the ring, its clock and its flash log: 'stamped' entries stamped and filled, the rtc set if 'setRtc',
+// then as much uploaded as the link takes.  returns the entries left in the log at the reset
+static const uint32_t
+boot(CollectSink &sink, const uint32_t stamped, const bool setRtc, uint32_t &dropped)
+{
+  SpiFlash flash;
+  FlashLog log(flash, 0, 16);
+  MotionClock clock;
+  NetworkRingBuffer ring(&sink);
+
+  if (!flash.begin(epochChipSelect) || !log.begin())
+  {
+    return 0;
+  }
+  ring.setClock(&clock);
+  ring.setSpill(&log);
+  (void) clock.now();
+  for (uint32_t i = 0; i < stamped; i++)
+  {
+    MotionEntry entry(0, 's', i * 16, 0, -1008);
+    clock.stamp(entry);
+    (void) ring.fill(entry);
+  }
+  if (setRtc)
+  {
+    Time.setTime(epoch);
+    (void) clock.now();
+  }
+  for (int i = 0; (i < 100) && (ring.drain(32) > 0); i++)
+  {
+  }
+  dropped = ring.dropped();
+
+  // a reset: whatever is left in the ring is lost with it
+  return log.entries();
+}
+
+// spills on the unset rtc, resets, maybe learns the epoch on a boot that still sees the rtc unset, then boots with
+// it set and the link up
+static const bool
+epochCase(const char *path, const bool learnt)
+{
+  SpiFlashSim part(epochChipSelect, path, 16 * SpiFlashSim::sectorSize, true);
+  CollectSink down(false);
+  CollectSink up(true);
+  uint32_t dropped;
+
+  Simulation::coldBoot();
+  uint32_t spilled = boot(down, NETWORK_SPILL_MARK + 64, false, dropped);
+  if (learnt)
+  {
+    (void) boot(down, 0, true, dropped);
+  }
+  else
+  {
+    // set by a boot that spilled nothing and reset before uploading
+    Time.setTime(epoch);
+  }
+  uint32_t left = boot(up, 0, false, dropped);
+
+  const char *name = learnt ? "epoch learnt before the reset" : "rtc set across the reset";
+  bool placed = (up._entries == spilled) && (up._earliest >= epoch - 60) && (up._latest <= Time.now());
+  bool ok = spilled && !left && (learnt ? placed && !dropped : !up._entries && (dropped == spilled));
+  printf("%s: %u entries spilled on the unset rtc, %u delivered", name, spilled, up._entries);
+  if (up._entries)
+  {
+    printf(" (%ld to %ld s from the epoch)", (long) (up._earliest - epoch), (long) (up._latest - epoch));
+  }
+  printf(", %u dropped: %s\n", dropped, ok ? "ok" : "WRONG");
+
+  return ok;
+}
+
+// record 'id' holds 1 to 32 entries, each saying which record and which entry of it it is
+static const uint16_t
+entriesOf(const uint32_t id)
+{
+  return 1 + id % 32;
+}
+
+static const uint16_t
+encode(const uint32_t id, uint8_t *frame)
+{
+  WireEncoder encoder;
+  size_t length = encoder.begin(frame, entriesOf(id), epoch + id);
+
+  for (uint16_t i = 0; i < entriesOf(id); i++)
+  {
+    length += encoder.encode(&frame[length], MotionEntry(epoch + id, 's', i * 16, (id & 0x7FF) * 16, -1008, i * 10000));
+  }
+
+  return length;
+}
+
+// the ids of the live records, checking every entry; false if any record is damaged
+static const bool
+recover(FlashLog &log, std::deque<uint32_t> &ids)
+{
+  uint32_t entries = 0;
+
+  ids.clear();
+  for (bool more = log.seek(0); more; more = log.advance())
+  {
+    MotionEntry entry;
+    uint32_t id = 0;
+    uint16_t count = 0;
+
+    while (log.next(entry))
+    {
+      id = entry._time - epoch;
+      if ((entry._x != count * 16) || (entry._y != (int16_t) ((id & 0x7FF) * 16)) || (entry._micros != count * 10000u))
+      {
+	fprintf(stderr, "record %u entry %u reads back wrong\n", id, count);
+	return false;
+      }
+      count++;
+    }
+    if (!count || (count != entriesOf(id)) || (count != log.recordEntries()))
+    {
+      fprintf(stderr, "record %zu after the head reads back %u entries\n", ids.size(), count);
+      return false;
+    }
+    ids.push_back(id);
+    entries += count;
+  }
+
+  if ((ids.size() != log.records()) || (entries != log.entries()))
+  {
+    fprintf(stderr, "log counts %u records of %u entries, read %zu of %u\n", log.records(), log.entries(), ids.size(), entries);
+    return false;
+  }
+
+  return true;
+}
+
+// what each record reads back as, checking every entry: its entries on the unset rtc's count as stamped (unknown), all
+// placed on the epoch by 'shift' (placed), or none (absent); false if any entry is none of these
+enum Reading
+{
+  absent,
+  unknown,
+  placed
+};
+
+static const bool
+readDated(FlashLog &log, const int64_t shift, std::vector<Reading> &records)
+{
+  records.clear();
+  for (bool more = log.seek(0); more; more = log.advance())
+  {
+    MotionEntry entry;
+    Reading reading = absent;
+    uint16_t count = 0;
+
+    while (log.next(entry))
+    {
+      uint32_t id = entry._y / 16;
+      int64_t stamped = (int64_t) (epoch + id) * 1000000 + count * 10000;
+      Reading is = entry._epochUnknown ? unknown : placed;
+      if ((entry._x != count * 16) || (WireFormat::micros(entry) != stamped + ((is == placed) ? shift : 0)) || (count && (is != reading)))
+      {
+	fprintf(stderr, "record %zu entry %u reads back wrong\n", records.size(), count);
+	return false;
+      }
+      reading = is;
+      count++;
+    }
+    if (count != ((reading == absent) ? 0 : log.recordEntries()))
+    {
+      return false;
+    }
+    records.push_back(reading);
+  }
+
+  return true;
+}
+
+// records of entries all stamped on the unset rtc, dated with the power cut at each byte of the dating in turn.  after
+// the cut each record reads as dated or not, never on a torn shift; a boot that learns the same shift then places
+// them all, and one that never saw the rtc unset ('known' false) keeps only those dated before the cut
+static const bool
+datingCase(const char *path, const bool known)
+{
+  const int64_t shift = 17 * 86400LL * 1000000 + 123457;
+  const uint32_t records = 4;
+  uint8_t frame[WireFormat::headerSize + 32 * WireFormat::maxEntrySize];
+  unsigned int wrong = 0;
+  uint64_t cut;
+
+  for (cut = 1; ; cut++)
+  {
+    SpiFlashSim part(epochChipSelect, path, 16 * SpiFlashSim::sectorSize, true);
+    std::vector<Reading> before;
+    std::vector<Reading> after;
+    uint32_t lost = 0;
+    uint32_t lose = 0;
+    bool finished;
+
+    {
+      SpiFlash flash;
+      FlashLog log(flash, 0, 16);
+      if (!flash.begin(epochChipSelect) || !log.begin())
+      {
+	return false;
+      }
+      for (uint32_t id = 1; id <= records; id++)
+      {
+	(void) log.append(frame, encode(id, frame), entriesOf(id), 0);
+      }
+      part.cutPowerAfter(cut);
+      (void) log.date(shift, true);
+      finished = part.powered();
+      part.cutPowerAfter(0);
+    }
+
+    {
+      SpiFlash flash;
+      FlashLog log(flash, 0, 16);
+      bool read = flash.begin(epochChipSelect) && log.begin() && readDated(log, shift, before) && (before.size() == records);
+      for (uint32_t i = 0; read && (i < records); i++)
+      {
+	read = (before[i] != absent);
+	lose += (before[i] == placed) ? 0 : entriesOf(i + 1);
+      }
+      lost = log.date(shift, known);
+      read = read && readDated(log, shift, after) && (after.size() == records);
+      for (uint32_t i = 0; read && (i < records); i++)
+      {
+	read = (after[i] == (known ? placed : before[i] == placed ? placed : absent));
+      }
+      if (!read || (lost != (known ? 0 : lose)))
+      {
+	if (wrong++ < 10)
+	{
+	  fprintf(stderr, "dating cut after %" PRIu64 " bytes: records misread, or %u entries lost\n", cut, lost);
+	}
+      }
+    }
+
+    if (finished)
+    {
+      break;
+    }
+  }
+
+  printf("dating cut at each of %" PRIu64 " bytes, then dated by a boot that %s: %u wrong: %s\n", cut - 1,
+	 known ? "knows the shift" : "never saw the rtc unset", wrong, wrong ? "WRONG" : "ok");
+
+  return !wrong;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *path = "/tmp/flashstress.bin";
+  unsigned int cuts = 1000;
+  uint32_t sectors = 16;
+  unsigned int seed = 1;
+  bool verbose = false;
+  int option;
+
+  while ((option = getopt(argc, argv, "n:s:r:v")) != -1)
+  {
+    switch (option)
+    {
+      case 'n': cuts = atoi(optarg); break;
+      case 's': sectors = atoi(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      case 'v': verbose = true; break;
+      default:
+	fprintf(stderr, "usage: %s [-n power cuts] [-s sectors] [-r seed] [-v] [flash file]\n", argv[0]);
+	return 1;
+    }
+  }
+  path = (optind < argc) ? argv[optind] : path;
+
+  Log._level = verbose ? LOG_LEVEL_TRACE : LOG_LEVEL_NONE;
+  SpiFlashSim part(chipSelect, path, sectors * SpiFlashSim::sectorSize, true);
+  if (!part.isOpen())
+  {
+    return 1;
+  }
+
+  std::mt19937 random(seed);
+  std::deque<uint32_t> model;	// what the log must hold
+  uint8_t frame[WireFormat::headerSize + 32 * WireFormat::maxEntrySize];
+  uint32_t nextId = 1;
+  uint64_t appended = 0;
+  uint64_t consumed = 0;
+  uint64_t full = 0;
+  unsigned int failures = 0;
+
+  for (unsigned int run = 0; run <= cuts; run++)
+  {
+    // boot
+    part.cutPowerAfter(0);
+    SpiFlash flash;
+    FlashLog log(flash, 0, sectors);
+    if (!flash.begin(chipSelect) || !log.begin())
+    {
+      fprintf(stderr, "run %u: the log did not start\n", run);
+      return 1;
+    }
+
+    std::deque<uint32_t> ids;
+    if (!recover(log, ids))
+    {
+      failures++;
+    }
+    else
+    {
+      // the one operation under way at the cut may have taken effect or not
+      std::deque<uint32_t> expected = model;
+      bool matches = (ids == expected);
+      if (!matches && !model.empty())
+      {
+	expected.pop_front();
+	matches = (ids == expected);
+      }
+      if (!matches)
+      {
+	expected = model;
+	expected.push_back(nextId - 1);
+	matches = (ids == expected);
+      }
+      if (!matches)
+      {
+	fprintf(stderr, "run %u: recovered %zu records (first %u), expected %zu (first %u)\n", run, ids.size(),
+		ids.empty() ? 0 : ids.front(), model.size(), model.empty() ? 0 : model.front());
+	failures++;
+      }
+    }
+    model = ids;
+
+    if (run == cuts)
+    {
+      break;
+    }
+
+    // run until the power fails somewhere in the next few hundred records' worth of writes
+    std::uniform_int_distribution<uint64_t> budget(1, 100000);
+    part.cutPowerAfter(budget(random));
+    while (part.powered())
+    {
+      std::uniform_int_distribution<int> choice(0, 9);
+      if (choice(random) < 6)
+      {
+	uint32_t id = nextId++;
+	uint16_t length = encode(id, frame);
+	bool stored = log.append(frame, length, entriesOf(id), entriesOf(id));
+	if (!part.powered())
+	{
+	  break;
+	}
+	if (stored)
+	{
+	  model.push_back(id);
+	  appended++;
+	}
+	else
+	{
+	  full++;
+	}
+      }
+      else if (!model.empty())
+      {
+	log.consume(1);
+	if (!part.powered())
+	{
+	  break;
+	}
+	model.pop_front();
+	consumed++;
+      }
+    }
+  }
+
+  const std::vector<uint32_t> &erases = part.eraseCounts();
+  uint32_t least = *std::min_element(erases.begin(), erases.end());
+  uint32_t most = *std::max_element(erases.begin(), erases.end());
+  printf("%u power cuts over %u sectors: %" PRIu64 " records appended (%" PRIu64 " refused while full), %" PRIu64 " consumed\n",
+	 cuts, sectors, appended, full, consumed);
+  printf("sector erases: least %u, most %u\n", least, most);
+  printf("%u inconsistent recoveries\n", failures);
+
+  std::string epochPath = std::string(path) + ".epoch";
+  failures += !epochCase(epochPath.c_str(), false);
+  failures += !epochCase(epochPath.c_str(), true);
+  failures += !datingCase(epochPath.c_str(), true);
+  failures += !datingCase(epochPath.c_str(), false);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,539 @@
+/*
+ * ingestd.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * ingest daemon for the tracker upload stream: many concurrent device sessions on one epoll loop, tcp and udp on
+ * the same port.  csv lines and binary frames are parsed in place (nothing is allocated per entry) and appended
+ * as csv to <dir>/<device>.csv, keyed by the device id from a binary session's hello, else by peer address; a
+ * device's file is created when its first entry is written.  a sequenced frame is written whole once its last entry
+ * arrives and then acknowledged, so a torn frame leaves nothing to be written twice, and resent frames are dropped,
+ * as host/receiver does.  only the most recently written files (-f, default 256) are held open, so the descriptors
+ * go to the sessions; a connection beyond what the limit leaves for them is accepted and closed at once (the device
+ * retries) rather than left to spin the loop.  throughput is reported on stderr every few seconds; drive it with
+ * host/ingestload
+ *
+ *   g++ -O2 -I.. -o ingestd ingestd.cpp ../WireFormat.cpp
+ *   ./ingestd [-p port] [-d directory] [-f open files]
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <list>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "WireFormat.h"
+
+class Device
+{
+public:
+  Device(const std::string &directory, const std::string &id)
+  : _path(directory + "/" + id + ".csv")
+  , _file(NULL)
+  , _haveLast(false)
+  , _lastSequence(0)
+  {
+  }
+
+  // anything well behind the last frame is taken to be a rebooted device rather than a resend
+  const bool isResend(const uint32_t sequence) const
+  {
+    return _haveLast && WireFormat::sequenceAtOrBefore(sequence, _lastSequence) && (_lastSequence - sequence < 64);
+  }
+
+  std::string _path;
+  FILE *_file;	// open while the device is in openFiles, see file()
+  std::list<Device *>::iterator _open;
+  bool _haveLast;
+  uint32_t _lastSequence;
+};
+
+class Connection
+{
+public:
+  Connection(const int fd, const std::string &peer)
+  : _fd(fd)
+  , _peer(peer)
+  , _device(NULL)
+  , _duplicate(false)
+  , _frameEntries(0)
+  , _length(0)
+  {
+  }
+
+  int _fd;
+  std::string _peer;
+  Device *_device;	// from the hello, or the peer address once entries come without one
+  WireDecoder _decoder;
+  bool _duplicate;
+  std::string _frame;	// rows of the sequenced frame being decoded
+  unsigned long _frameEntries;
+  size_t _length;
+  uint8_t _buffer[16384];
+};
+
+static std::string directory(".");
+static std::unordered_map<std::string, Device *> devices;
+static std::list<Device *> openFiles;	// most recently written first
+static size_t maxOpenFiles = 256;
+static unsigned long long totalEntries = 0;
+static unsigned long long totalBytes = 0;
+static unsigned long long totalDuplicates = 0;
+static unsigned long long totalCorrupt = 0;
+static unsigned long sessions = 0;
+static unsigned long openSessions = 0;
+static unsigned long maxSessions = 0;	// what the descriptor limit leaves beside the files, see main()
+static unsigned long refused = 0;
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static Device *
+device(const std::string &id)
+{
+  auto found = devices.find(id);
+
+  if (found != devices.end())
+  {
+    return found->second;
+  }
+
+  Device *created = new Device(directory, id);
+  devices[id] = created;
+
+  return created;
+}
+
+static Device *
+source(Connection &connection)
+{
+  if (!connection._device)
+  {
+    connection._device = device(connection._peer);
+  }
+
+  return connection._device;
+}
+
+static void
+closeOldest()
+{
+  Device *oldest = openFiles.back();
+  fclose(oldest->_file);
+  oldest->_file = NULL;
+  openFiles.pop_back();
+}
+
+// the device's file, opened (and created) if it is not, closing the least recently written one to make room, and
+// more while the sessions have the descriptors; NULL if there is none to be had
+static FILE *
+file(Device *target)
+{
+  if (target->_file)
+  {
+    openFiles.splice(openFiles.begin(), openFiles, target->_open);
+    return target->_file;
+  }
+
+  if (openFiles.size() >= maxOpenFiles)
+  {
+    closeOldest();
+  }
+  while (!(target->_file = fopen(target->_path.c_str(), "a")) && ((errno == EMFILE) || (errno == ENFILE)) && !openFiles.empty())
+  {
+    closeOldest();
+  }
+  if (!target->_file)
+  {
+    perror(target->_path.c_str());
+    return NULL;
+  }
+  setvbuf(target->_file, NULL, _IOFBF, 1 << 16);
+  openFiles.push_front(target);
+  target->_open = openFiles.begin();
+
+  return target->_file;
+}
+
+static void
+append(Device *target, const MotionEntry &entry)
+{
+  char line[128];
+  int size = WireFormat::formatCsv(line, sizeof(line), entry);
+
+  if (FILE *out = file(target))
+  {
+    fwrite(line, 1, size, out);
+  }
+  totalEntries++;
+}
+
+// parses complete csv lines and binary entries from the front of buffer; returns bytes used, -1 on corrupt input,
+// -2 when a frame could not be written (and so is not acknowledged)
+static int
+consume(Connection &connection, const uint8_t *buffer, const size_t length, const bool datagram)
+{
+  WireDecoder &decoder = connection._decoder;
+  size_t used = 0;
+
+  while (used < length)
+  {
+    if ((decoder.remaining() == 0) && (buffer[used] != WireFormat::magic))
+    {
+      const uint8_t *end = (const uint8_t *) memchr(&buffer[used], '\n', length - used);
+      if (!end)
+      {
+	// a datagram holds whole lines, the last one may simply lack its newline
+	if (!datagram)
+	{
+	  break;
+	}
+	end = buffer + length;
+      }
+
+      MotionEntry entry;
+      if (WireFormat::parseCsv((const char *) &buffer[used], end - &buffer[used], entry))
+      {
+	append(source(connection), entry);
+      }
+      else
+      {
+	totalCorrupt++;
+      }
+      used = (end < buffer + length) ? end - buffer + 1 : length;
+      continue;
+    }
+
+    MotionEntry entry;
+    bool decoded;
+    bool header = (decoder.remaining() == 0);
+    int consumed = decoder.next(&buffer[used], length - used, entry, decoded);
+    if (consumed <= 0)
+    {
+      return (consumed < 0) ? -1 : (int) used;
+    }
+    used += consumed;
+
+    const char *id;
+    if (decoder.hello(id))
+    {
+      connection._device = device(id);
+      continue;
+    }
+
+    uint32_t sequence;
+    if (header)
+    {
+      connection._duplicate = decoder.sequenced(sequence) && source(connection)->isResend(sequence);
+      // whatever a torn frame left is resent from its start
+      connection._frame.clear();
+      connection._frameEntries = 0;
+    }
+    if (decoded && !connection._duplicate)
+    {
+      if (!datagram && decoder.sequenced(sequence))
+      {
+	char line[128];
+	connection._frame.append(line, WireFormat::formatCsv(line, sizeof(line), entry));
+	connection._frameEntries++;
+      }
+      else
+      {
+	append(source(connection), entry);
+      }
+    }
+
+    if (!datagram && decoder.frameDone(sequence))
+    {
+      Device *target = source(connection);
+      FILE *out = NULL;
+      if (connection._duplicate)
+      {
+	totalDuplicates++;
+	sequence = target->_lastSequence;
+      }
+      else
+      {
+	if (!(out = file(target)))
+	{
+	  return -2;
+	}
+	fwrite(connection._frame.data(), 1, connection._frame.size(), out);
+	totalEntries += connection._frameEntries;
+	target->_haveLast = true;
+	target->_lastSequence = sequence;
+      }
+      connection._frame.clear();
+      connection._frameEntries = 0;
+
+      // persisted (as far as the page cache) before acknowledging
+      if (out)
+      {
+	fflush(out);
+      }
+      uint8_t ack[WireFormat::ackSize];
+      WireFormat::encodeAck(ack, sequence);
+      if (write(connection._fd, ack, sizeof(ack)) != (ssize_t) sizeof(ack))
+      {
+	return -1;
+      }
+    }
+  }
+
+  return used;
+}
+
+static std::string
+peerName(const struct sockaddr_in &peer)
+{
+  return inet_ntoa(peer.sin_addr);
+}
+
+static void
+closeConnection(const int poll, Connection *connection)
+{
+  epoll_ctl(poll, EPOLL_CTL_DEL, connection->_fd, NULL);
+  close(connection->_fd);
+  openSessions--;
+  if (connection->_device && connection->_device->_file)
+  {
+    fflush(connection->_device->_file);
+  }
+  delete connection;
+}
+
+static void
+readConnection(const int poll, Connection *connection)
+{
+  for (;;)
+  {
+    ssize_t got = read(connection->_fd, &connection->_buffer[connection->_length], sizeof(connection->_buffer) - connection->_length);
+
+    if (got < 0)
+    {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      {
+	closeConnection(poll, connection);
+      }
+      return;
+    }
+    if (got == 0)
+    {
+      closeConnection(poll, connection);
+      return;
+    }
+
+    connection->_length += got;
+    totalBytes += got;
+
+    int used = consume(*connection, connection->_buffer, connection->_length, false);
+    if (used < 0)
+    {
+      // the device resends an unacknowledged frame in its next session
+      fprintf(stderr, "%s stream from %s; dropping session\n", (used == -2) ? "unwritable" : "corrupt", connection->_peer.c_str());
+      totalCorrupt += (used == -1);
+      closeConnection(poll, connection);
+      return;
+    }
+    memmove(connection->_buffer, &connection->_buffer[used], connection->_length - used);
+    connection->_length -= used;
+  }
+}
+
+static void
+readDatagrams(const int udp)
+{
+  static uint8_t datagram[65536];
+  static Connection scratch(-1, "");
+  struct sockaddr_in peer;
+  socklen_t peerLength = sizeof(peer);
+  ssize_t got;
+
+  while ((got = recvfrom(udp, datagram, sizeof(datagram), 0, (struct sockaddr *) &peer, &peerLength)) > 0)
+  {
+    // every datagram is self-contained, so a decoder reset per datagram is all the state needed
+    scratch._decoder.reset();
+    scratch._duplicate = false;
+    scratch._device = device(peerName(peer));
+    totalBytes += got;
+    if (consume(scratch, datagram, got, true) != got)
+    {
+      totalCorrupt++;
+    }
+    peerLength = sizeof(peer);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int port = 32768;
+  int option;
+
+  while ((option = getopt(argc, argv, "p:d:f:")) != -1)
+  {
+    switch (option)
+    {
+      case 'p':
+	port = atoi(optarg);
+	break;
+      case 'd':
+	directory = optarg;
+	mkdir(optarg, 0755);
+	break;
+      case 'f':
+	maxOpenFiles = (atoi(optarg) > 0) ? atoi(optarg) : 1;
+	break;
+      default:
+	fprintf(stderr, "usage: %s [-p port] [-d directory] [-f open files]\n", argv[0]);
+	return 1;
+    }
+  }
+
+  // a descriptor per session, as many as the hard limit allows once the files and the daemon's own have theirs, and
+  // one held back for refusing connections with should the system run out first
+  struct rlimit limit;
+  if (!getrlimit(RLIMIT_NOFILE, &limit) && (limit.rlim_cur < limit.rlim_max))
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+  if (maxOpenFiles > limit.rlim_cur / 4)
+  {
+    maxOpenFiles = limit.rlim_cur / 4;
+  }
+  maxSessions = limit.rlim_cur - maxOpenFiles - 16;
+  int reserve = open("/dev/null", O_RDONLY);
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+
+  int on = 1;
+  int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  int udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if ((bind(listener, (struct sockaddr *) &address, sizeof(address)) < 0) || (listen(listener, 1024) < 0)
+      || (bind(udp, (struct sockaddr *) &address, sizeof(address)) < 0))
+  {
+    perror("bind");
+    return 1;
+  }
+
+  int poll = epoll_create1(0);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  epoll_ctl(poll, EPOLL_CTL_ADD, listener, &event);
+  event.data.ptr = &udp;
+  epoll_ctl(poll, EPOLL_CTL_ADD, udp, &event);
+  fprintf(stderr, "ingesting on tcp/udp %d into %s\n", port, directory.c_str());
+
+  double reported = now();
+  unsigned long long reportedEntries = 0;
+  unsigned long long reportedBytes = 0;
+  struct epoll_event events[256];
+
+  for (;;)
+  {
+    int ready = epoll_wait(poll, events, sizeof(events) / sizeof(events[0]), 1000);
+
+    for (int i = 0; i < ready; i++)
+    {
+      if (events[i].data.ptr == NULL)
+      {
+	struct sockaddr_in peer;
+	socklen_t peerLength = sizeof(peer);
+	int fd;
+
+	for (;;)
+	{
+	  fd = accept4(listener, (struct sockaddr *) &peer, &peerLength, SOCK_NONBLOCK);
+	  if (fd < 0)
+	  {
+	    if (((errno != EMFILE) && (errno != ENFILE)) || (reserve < 0))
+	    {
+	      break;
+	    }
+	    // out of descriptors: the listener stays readable until the connection is taken, so take it on the reserve
+	    // and close it, and the device retries later
+	    close(reserve);
+	    fd = accept(listener, NULL, NULL);
+	    if (fd >= 0)
+	    {
+	      close(fd);
+	      refused++;
+	    }
+	    reserve = open("/dev/null", O_RDONLY);
+	    if (fd < 0)
+	    {
+	      break;
+	    }
+	    peerLength = sizeof(peer);
+	    continue;
+	  }
+
+	  peerLength = sizeof(peer);
+	  if (openSessions >= maxSessions)
+	  {
+	    close(fd);
+	    refused++;
+	    continue;
+	  }
+
+	  // acks are tiny and latency bound
+	  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	  Connection *connection = new Connection(fd, peerName(peer));
+	  event.events = EPOLLIN;
+	  event.data.ptr = connection;
+	  epoll_ctl(poll, EPOLL_CTL_ADD, fd, &event);
+	  sessions++;
+	  openSessions++;
+	}
+      }
+      else if (events[i].data.ptr == &udp)
+      {
+	readDatagrams(udp);
+      }
+      else
+      {
+	readConnection(poll, (Connection *) events[i].data.ptr);
+      }
+    }
+
+    double current = now();
+    if (current - reported >= 5.0)
+    {
+      double elapsed = current - reported;
+      fprintf(stderr, "%lu sessions (%lu refused), %zu devices: %.0f entries/s, %.2f MB/s (%llu entries, %llu resent frames ignored, %llu corrupt)\n",
+	      sessions, refused, devices.size(), (totalEntries - reportedEntries) / elapsed, (totalBytes - reportedBytes) / elapsed / 1e6,
+	      totalEntries, totalDuplicates, totalCorrupt);
+      reported = current;
+      reportedEntries = totalEntries;
+      reportedBytes = totalBytes;
+    }
+  }
+
+  return 0;
+}
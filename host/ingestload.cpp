@@ -0,0 +1,244 @@
+/*
+ * ingestload.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * simulated device fleet for sizing ingestd: opens one session per device, introduces it with a hello and streams
+ * acknowledged binary frames (or csv lines) with up to four frames in flight, the way NetworkRingBuffer does
+ *
+ *   g++ -O2 -I.. -o ingestload ingestload.cpp ../WireFormat.cpp
+ *   ./ingestload [-h host] [-p port] [-c devices] [-f frames per device] [-e entries per frame] [-s]  (-s: csv)
+ * both ends hold a descriptor per device, so raise ulimit -n past the device count for fleets in the thousands
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+#include "WireFormat.h"
+
+class SimulatedDevice
+{
+public:
+  int _fd;
+  uint32_t _nextSequence;
+  uint32_t _acked;
+  unsigned int _framesSent;
+  unsigned int _framesAcked;
+  size_t _ackLength;
+  uint8_t _ack[WireFormat::ackSize];
+  std::vector<uint8_t> _pending;	// bytes of the current frame not yet accepted by the socket
+  size_t _pendingOffset;
+  bool _done;
+};
+
+// writes until the window is full or the socket pushes back; returns true if it wants to hear about writability
+static bool
+pump(SimulatedDevice &device, const unsigned int frames, const unsigned int entries, const bool csv, unsigned int &seed, unsigned long long &bytes);
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// one frame's worth of plausible samples; 400 Hz streaming at rest with a little noise
+static void
+buildFrame(std::vector<uint8_t> &out, const uint32_t sequence, const unsigned int entries, const bool csv, unsigned int &seed)
+{
+  WireEncoder encoder;
+  uint8_t scratch[128];
+  time_t base = 1486922645 + sequence;
+
+  out.clear();
+  if (!csv)
+  {
+    out.insert(out.end(), scratch, scratch + encoder.begin(scratch, entries, base, sequence));
+  }
+  for (unsigned int i = 0; i < entries; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    MotionEntry entry(base + i / 400, 's', (int16_t) (((seed >> 16) & 0x3F) - 32) * 16, (int16_t) (((seed >> 8) & 0x3F) - 32) * 16, 1008, (i % 400) * 2500);
+
+    if (csv)
+    {
+      int size = WireFormat::formatCsv((char *) scratch, sizeof(scratch), entry);
+      out.insert(out.end(), scratch, scratch + size);
+    }
+    else
+    {
+      out.insert(out.end(), scratch, scratch + encoder.encode(scratch, entry));
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *host = "127.0.0.1";
+  int port = 32768;
+  unsigned int count = 1000;
+  unsigned int frames = 100;
+  unsigned int entries = 128;
+  bool csv = false;
+  int option;
+
+  while ((option = getopt(argc, argv, "h:p:c:f:e:s")) != -1)
+  {
+    switch (option)
+    {
+      case 'h': host = optarg; break;
+      case 'p': port = atoi(optarg); break;
+      case 'c': count = atoi(optarg); break;
+      case 'f': frames = atoi(optarg); break;
+      case 'e': entries = atoi(optarg); break;
+      case 's': csv = true; break;
+      default:
+	fprintf(stderr, "usage: %s [-h host] [-p port] [-c devices] [-f frames] [-e entries] [-s]\n", argv[0]);
+	return 1;
+    }
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  inet_pton(AF_INET, host, &address.sin_addr);
+
+  int poll = epoll_create1(0);
+  std::vector<SimulatedDevice> devices(count);
+  unsigned int seed = 1;
+  unsigned long long bytes = 0;
+  double start = now();
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    SimulatedDevice &device = devices[i];
+    char id[WireFormat::maxDeviceId + 1];
+    uint8_t hello[4 + WireFormat::maxDeviceId];
+
+    device._fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(device._fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+    {
+      perror("connect");
+      return 1;
+    }
+    snprintf(id, sizeof(id), "sim%05u", i);
+    if (!csv)
+    {
+      write(device._fd, hello, WireFormat::encodeHello(hello, id));
+    }
+    device._nextSequence = i * 7919;
+    device._acked = device._nextSequence - 1;
+    device._framesSent = device._framesAcked = 0;
+    device._ackLength = 0;
+    device._pendingOffset = 0;
+    device._done = false;
+    fcntl(device._fd, F_SETFL, fcntl(device._fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.ptr = &device;
+    epoll_ctl(poll, EPOLL_CTL_ADD, device._fd, &event);
+  }
+
+  unsigned int finished = 0;
+  struct epoll_event events[256];
+
+  while (finished < count)
+  {
+    int ready = epoll_wait(poll, events, sizeof(events) / sizeof(events[0]), 5000);
+    if (ready == 0)
+    {
+      fprintf(stderr, "stalled with %u of %u devices finished\n", finished, count);
+      break;
+    }
+
+    for (int i = 0; i < ready; i++)
+    {
+      SimulatedDevice &device = *(SimulatedDevice *) events[i].data.ptr;
+
+      if (events[i].events & EPOLLIN)
+      {
+	ssize_t got = read(device._fd, &device._ack[device._ackLength], sizeof(device._ack) - device._ackLength);
+	if (got <= 0)
+	{
+	  fprintf(stderr, "session closed by ingestd\n");
+	  return 1;
+	}
+	device._ackLength += got;
+
+	uint32_t sequence;
+	if (WireFormat::decodeAck(device._ack, device._ackLength, sequence) > 0)
+	{
+	  device._ackLength = 0;
+	  while (WireFormat::sequenceAtOrBefore(device._acked + 1, sequence))
+	  {
+	    device._acked++;
+	    device._framesAcked++;
+	  }
+	}
+      }
+
+      struct epoll_event event;
+      event.events = pump(device, frames, entries, csv, seed, bytes) ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+      event.data.ptr = &device;
+      epoll_ctl(poll, EPOLL_CTL_MOD, device._fd, &event);
+
+      if (!device._done && (device._framesSent == frames) && (csv || (device._framesAcked == frames)))
+      {
+	device._done = true;
+	finished++;
+	epoll_ctl(poll, EPOLL_CTL_DEL, device._fd, NULL);
+	close(device._fd);
+      }
+    }
+  }
+
+  double elapsed = now() - start;
+  unsigned long long total = (unsigned long long) finished * frames * entries;
+  printf("%u devices x %u frames x %u entries (%s): %.2f s, %.0f entries/s, %.2f MB/s, %.1f bytes/entry\n",
+	 count, frames, entries, csv ? "csv" : "acked binary", elapsed, total / elapsed, bytes / elapsed / 1e6, total ? (double) bytes / total : 0.0);
+
+  return finished == count ? 0 : 1;
+}
+
+static bool
+pump(SimulatedDevice &device, const unsigned int frames, const unsigned int entries, const bool csv, unsigned int &seed, unsigned long long &bytes)
+{
+  // keep up to four frames in flight (csv has no acks, so just keep writing)
+  while ((device._framesSent < frames) && (csv || (device._framesSent - device._framesAcked < 4)))
+  {
+    if (device._pendingOffset == device._pending.size())
+    {
+      buildFrame(device._pending, device._nextSequence++, entries, csv, seed);
+      device._pendingOffset = 0;
+    }
+
+    ssize_t wrote = write(device._fd, &device._pending[device._pendingOffset], device._pending.size() - device._pendingOffset);
+    if (wrote < 0)
+    {
+      return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+    }
+    bytes += wrote;
+    device._pendingOffset += wrote;
+    if (device._pendingOffset < device._pending.size())
+    {
+      return true;
+    }
+    device._framesSent++;
+  }
+
+  return false;
+}
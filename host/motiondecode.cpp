@@ -0,0 +1,73 @@
+/*
+ * motiondecode.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * host-side decoder for the binary upload framing; turns a captured stream back into the csv lines
+ * the device sends in csv mode
+ *
+ *   g++ -O2 -I.. -o motiondecode motiondecode.cpp ../WireFormat.cpp
+ *   nc -l 32768 | ./motiondecode > motion.csv
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "WireFormat.h"
+
+int
+main(int argc, char *argv[])
+{
+  FILE *in = stdin;
+
+  if ((argc > 1) && !(in = fopen(argv[1], "rb")))
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  uint8_t buffer[4096];
+  size_t length = 0;
+  size_t bytes = 0;
+  unsigned long entries = 0;
+  WireDecoder decoder;
+  char line[128];
+
+  while (size_t got = fread(&buffer[length], 1, sizeof(buffer) - length, in))
+  {
+    length += got;
+    bytes += got;
+
+    size_t used = 0;
+    while (used < length)
+    {
+      MotionEntry entry;
+      bool decoded;
+      int consumed = decoder.next(&buffer[used], length - used, entry, decoded);
+
+      if (consumed < 0)
+      {
+	fprintf(stderr, "corrupt stream at byte %lu\n", (unsigned long) (bytes - length + used));
+	return 2;
+      }
+      if (consumed == 0)
+      {
+	break;
+      }
+      used += consumed;
+
+      if (decoded)
+      {
+	WireFormat::formatCsv(line, sizeof(line), entry);
+	fputs(line, stdout);
+	entries++;
+      }
+    }
+
+    memmove(buffer, &buffer[used], length - used);
+    length -= used;
+  }
+
+  fprintf(stderr, "%lu entries from %lu bytes (%.1f bytes/entry)\n", entries, (unsigned long) bytes, entries ? (double) bytes / entries : 0.0);
+  return (length == 0) ? 0 : 3;
+}
@@ -0,0 +1,224 @@
+/*
+ * motionquery.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * range queries over a motionstore file: mmaps it, skips chunks outside the range by their time bounds and reports
+ * per-minute aggregates.  with -d the interrupt counts are folded into minute-of-day slots exactly as
+ * ActivityDigest::registerActivity() does on the device (its minute tier: the day up to the newest minute counted,
+ * every minute but that one rounded to its LogCount byte), printed like
+ * ActivityDigest::dump(), so a device digest can be checked against the raw data
+ *
+ *   g++ -O3 -I.. -o motionquery motionquery.cpp ../WireFormat.cpp
+ *   ./motionquery device.mcol [-f 2017-02-12T00:00:00Z] [-t 2017-02-13T00:00:00Z] [-d]
+ */
+
+#include <fcntl.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ColumnStore.h"
+#include "LogCount.h"
+#include "WireFormat.h"
+
+typedef struct Minute
+{
+  uint32_t _entries;
+  uint32_t _interrupts;
+  int64_t _x, _y, _z;
+} Minute;
+
+static const bool
+parseTime(const char *text, int64_t &when)
+{
+  // ISO8601 as the device writes it, or plain epoch seconds
+  char line[128];
+  MotionEntry entry;
+
+  snprintf(line, sizeof(line), "%s,x,0,0,0", text);
+  if (WireFormat::parseCsv(line, strlen(line), entry))
+  {
+    when = entry._time;
+    return true;
+  }
+
+  char *end;
+  when = strtoll(text, &end, 10);
+  return *text && !*end;
+}
+
+// sums over [begin, end) of one minute's rows; plain loops over the decoded columns so the compiler vectorizes them
+static void
+accumulate(Minute &minute, const int32_t *mode, const int32_t *x, const int32_t *y, const int32_t *z, const uint32_t begin, const uint32_t end)
+{
+  uint32_t interrupts = 0;
+  int64_t sumX = 0, sumY = 0, sumZ = 0;
+
+  for (uint32_t i = begin; i < end; i++)
+  {
+    interrupts += (mode[i] == 1);
+    sumX += x[i];
+    sumY += y[i];
+    sumZ += z[i];
+  }
+
+  minute._entries += end - begin;
+  minute._interrupts += interrupts;
+  minute._x += sumX;
+  minute._y += sumY;
+  minute._z += sumZ;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int64_t from = INT64_MIN;
+  int64_t to = INT64_MAX;
+  bool digest = false;
+  int option;
+
+  while ((option = getopt(argc, argv, "f:t:d")) != -1)
+  {
+    switch (option)
+    {
+      case 'f':
+	if (!parseTime(optarg, from))
+	{
+	  fprintf(stderr, "cannot parse time %s\n", optarg);
+	  return 1;
+	}
+	break;
+      case 't':
+	if (!parseTime(optarg, to))
+	{
+	  fprintf(stderr, "cannot parse time %s\n", optarg);
+	  return 1;
+	}
+	break;
+      case 'd':
+	digest = true;
+	break;
+      default:
+	fprintf(stderr, "usage: %s file.mcol [-f from] [-t to] [-d]\n", argv[0]);
+	return 1;
+    }
+  }
+  if (optind >= argc)
+  {
+    fprintf(stderr, "usage: %s file.mcol [-f from] [-t to] [-d]\n", argv[0]);
+    return 1;
+  }
+
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat status;
+  if ((fd < 0) || (fstat(fd, &status) < 0) || ((size_t) status.st_size < sizeof(ColumnStore::Footer)))
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+  const uint8_t *file = (const uint8_t *) mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const ColumnStore::Footer *footer = (const ColumnStore::Footer *) (file + status.st_size - sizeof(ColumnStore::Footer));
+  if ((file == MAP_FAILED) || (footer->_magic != ColumnStore::magic) || (footer->_version != ColumnStore::version))
+  {
+    fprintf(stderr, "%s is not a motionstore file\n", argv[optind]);
+    return 1;
+  }
+  const ColumnStore::ChunkInfo *index = (const ColumnStore::ChunkInfo *) (file + footer->_indexOffset);
+
+  static int32_t columns[ColumnStore::columns][ColumnStore::rowsPerChunk];
+  std::map<int64_t, Minute> minutes;
+  uint32_t slots[60 * 24];
+  uint32_t scanned = 0;
+  uint64_t matched = 0;
+
+  memset(slots, 0, sizeof(slots));
+  for (uint32_t c = 0; c < footer->_chunks; c++)
+  {
+    const ColumnStore::ChunkInfo &chunk = index[c];
+    if ((chunk._maxTime < from) || (chunk._minTime >= to))
+    {
+      continue;
+    }
+    scanned++;
+
+    // minutes need nothing finer than the second
+    for (int k = 0; k < ColumnStore::microsColumn; k++)
+    {
+      const ColumnStore::ColumnInfo &info = chunk._column[k];
+      ColumnStore::unpack(columns[k], (const uint64_t *) (file + info._offset), chunk._rows, info._base, info._width);
+    }
+    // time stays relative to the chunk minimum so it fits 32 bits
+    ColumnStore::integrate(columns[ColumnStore::timeColumn], chunk._rows);
+
+    const int32_t *time = columns[ColumnStore::timeColumn];
+    const int32_t *mode = columns[ColumnStore::modeColumn];
+    uint32_t i = 0;
+    while (i < chunk._rows)
+    {
+      int64_t when = chunk._minTime + time[i];
+      int64_t minute = when - (((when % 60) + 60) % 60);
+      uint32_t end = i + 1;
+
+      // rows arrive in time order, so a minute is normally one contiguous run
+      while ((end < chunk._rows) && (chunk._minTime + time[end] >= minute) && (chunk._minTime + time[end] < minute + 60))
+      {
+	end++;
+      }
+      // trim a run that straddles either end of the range
+      uint32_t first = i, last = end;
+      while ((first < last) && (chunk._minTime + time[first] < from)) first++;
+      while ((last > first) && (chunk._minTime + time[last - 1] >= to)) last--;
+      if (first < last)
+      {
+	accumulate(minutes[minute], mode, columns[ColumnStore::xColumn], columns[ColumnStore::yColumn], columns[ColumnStore::zColumn], first, last);
+	matched += last - first;
+      }
+      i = end;
+    }
+  }
+
+  // the device's minute tier holds the 1440 minutes up to the newest; older ones were cleared as it moved on
+  int64_t newest = minutes.empty() ? 0 : minutes.rbegin()->first;
+  char stamp[128];
+  for (std::map<int64_t, Minute>::const_iterator m = minutes.begin(); m != minutes.end(); ++m)
+  {
+    const Minute &minute = m->second;
+    if (digest)
+    {
+      // ActivityDigest::timeOffset(): hour * 60 + minute of the (utc) timestamp
+      int64_t offset = ((m->first % 86400) + 86400) % 86400 / 60;
+      if (m->first > newest - 86400)
+      {
+	slots[offset] = (m->first == newest) ? minute._interrupts : LogCount::decode(LogCount::encode(minute._interrupts));
+      }
+      continue;
+    }
+    WireFormat::formatCsv(stamp, sizeof(stamp), MotionEntry(m->first, 'x', 0, 0, 0));
+    strcpy(strchr(stamp, '.'), "Z");
+    printf("%s entries=%u interrupts=%u mean=%.1f,%.1f,%.1f\n", stamp, minute._entries, minute._interrupts,
+	   (double) minute._x / minute._entries, (double) minute._y / minute._entries, (double) minute._z / minute._entries);
+  }
+
+  if (digest)
+  {
+    printf("Digest info:\n");
+    for (int i = 0; i < 60 * 24; i++)
+    {
+      if (slots[i])
+      {
+	printf("slot[%d] = %u\n", i, slots[i]);
+      }
+    }
+  }
+
+  fprintf(stderr, "%u of %u chunks scanned, %llu rows matched, %zu minutes\n", scanned, footer->_chunks, (unsigned long long) matched, minutes.size());
+  munmap((void *) file, status.st_size);
+  close(fd);
+
+  return 0;
+}
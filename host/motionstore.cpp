@@ -0,0 +1,179 @@
+/*
+ * motionstore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * converts ingested csv (as written by ingestd/receiver, i.e. the device's csv upload format) into the chunked
+ * columnar layout described in ColumnStore.h; query it with motionquery
+ *
+ *   g++ -O2 -I.. -o motionstore motionstore.cpp ../WireFormat.cpp
+ *   ./motionstore device.mcol < device.csv
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ColumnStore.h"
+#include "WireFormat.h"
+
+class ChunkWriter
+{
+public:
+  ChunkWriter(FILE *out)
+  : _out(out)
+  , _offset(0)
+  , _rows(0)
+  {
+    for (int c = 0; c < ColumnStore::columns; c++)
+    {
+      _values[c].reserve(ColumnStore::rowsPerChunk);
+    }
+  }
+
+  void add(const MotionEntry &entry)
+  {
+    _values[ColumnStore::timeColumn].push_back(entry._time);
+    _values[ColumnStore::modeColumn].push_back(ColumnStore::modeCode(entry._mode));
+    _values[ColumnStore::xColumn].push_back(entry._x);
+    _values[ColumnStore::yColumn].push_back(entry._y);
+    _values[ColumnStore::zColumn].push_back(entry._z);
+    _values[ColumnStore::microsColumn].push_back(entry._micros);
+    if (_values[ColumnStore::timeColumn].size() == ColumnStore::rowsPerChunk)
+    {
+      flush();
+    }
+  }
+
+  void flush()
+  {
+    uint32_t rows = _values[ColumnStore::timeColumn].size();
+    if (!rows)
+    {
+      return;
+    }
+
+    ColumnStore::ChunkInfo chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk._rows = rows;
+
+    const std::vector<int64_t> &time = _values[ColumnStore::timeColumn];
+    chunk._minTime = time[0];
+    chunk._maxTime = time[0];
+    for (uint32_t i = 1; i < rows; i++)
+    {
+      chunk._minTime = (time[i] < chunk._minTime) ? time[i] : chunk._minTime;
+      chunk._maxTime = (time[i] > chunk._maxTime) ? time[i] : chunk._maxTime;
+    }
+    _deltas.resize(rows);
+    ColumnStore::deltas(_deltas.data(), time.data(), rows, chunk._minTime);
+
+    for (int c = 0; c < ColumnStore::columns; c++)
+    {
+      const std::vector<int64_t> &values = (c == ColumnStore::timeColumn) ? _deltas : _values[c];
+      int64_t low = values[0];
+      int64_t high = values[0];
+      for (uint32_t i = 1; i < rows; i++)
+      {
+	low = (values[i] < low) ? values[i] : low;
+	high = (values[i] > high) ? values[i] : high;
+      }
+
+      ColumnStore::ColumnInfo &info = chunk._column[c];
+      info._base = low;
+      info._width = ColumnStore::widthFor((uint64_t) (high - low));
+      info._offset = _offset;
+
+      _words.clear();
+      ColumnStore::pack(_words, values.data(), rows, low, info._width);
+      fwrite(_words.data(), sizeof(uint64_t), _words.size(), _out);
+      _offset += _words.size() * sizeof(uint64_t);
+
+      if (c == ColumnStore::modeColumn)
+      {
+	for (uint32_t i = 0; i < rows; i++)
+	{
+	  chunk._interrupts += (values[i] == 1);
+	}
+      }
+    }
+
+    _index.push_back(chunk);
+    _rows += rows;
+    for (int c = 0; c < ColumnStore::columns; c++)
+    {
+      _values[c].clear();
+    }
+  }
+
+  void finish()
+  {
+    flush();
+
+    ColumnStore::Footer footer;
+    memset(&footer, 0, sizeof(footer));
+    footer._indexOffset = _offset;
+    footer._chunks = _index.size();
+    footer._version = ColumnStore::version;
+    footer._rows = _rows;
+    footer._magic = ColumnStore::magic;
+    fwrite(_index.data(), sizeof(ColumnStore::ChunkInfo), _index.size(), _out);
+    fwrite(&footer, sizeof(footer), 1, _out);
+  }
+
+  const uint64_t rows() const { return _rows; }
+  const uint64_t bytes() const { return _offset + _index.size() * sizeof(ColumnStore::ChunkInfo) + sizeof(ColumnStore::Footer); }
+  const size_t chunks() const { return _index.size(); }
+
+protected:
+  FILE *_out;
+  uint64_t _offset;
+  uint64_t _rows;
+  std::vector<int64_t> _values[ColumnStore::columns];
+  std::vector<int64_t> _deltas;	// the time column as stored
+  std::vector<uint64_t> _words;
+  std::vector<ColumnStore::ChunkInfo> _index;
+};
+
+int
+main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s output.mcol < input.csv\n", argv[0]);
+    return 1;
+  }
+
+  FILE *out = fopen(argv[1], "wb");
+  if (!out)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  ChunkWriter writer(out);
+  char line[256];
+  unsigned long rejected = 0;
+  unsigned long long inputBytes = 0;
+
+  while (fgets(line, sizeof(line), stdin))
+  {
+    size_t length = strlen(line);
+    MotionEntry entry;
+
+    inputBytes += length;
+    if (!WireFormat::parseCsv(line, length, entry))
+    {
+      rejected++;
+      continue;
+    }
+    writer.add(entry);
+  }
+  writer.finish();
+  fclose(out);
+
+  fprintf(stderr, "%llu rows in %zu chunks, %llu bytes (%.2f bytes/row, csv was %.2f), %lu malformed lines skipped\n",
+	  (unsigned long long) writer.rows(), writer.chunks(), (unsigned long long) writer.bytes(),
+	  writer.rows() ? (double) writer.bytes() / writer.rows() : 0.0, writer.rows() ? (double) inputBytes / writer.rows() : 0.0, rejected);
+
+  return 0;
+}
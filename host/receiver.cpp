@@ -0,0 +1,215 @@
+/*
+ * receiver.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * local stand-in for the upload server: accepts one device session at a time, takes csv lines and binary frames
+ * (switching is allowed at hunk boundaries), writes csv to stdout and reports per-session throughput on stderr.
+ * sequenced frames are written out whole once their last entry arrives, then acknowledged, so a frame torn by a
+ * dropped session leaves nothing behind; resent frames it already has are acknowledged but not repeated.
+ * point a device at it with the 'upload-host' cloud function, e.g. particle call <device> upload-host 192.168.1.20:32768
+ *
+ *   g++ -O2 -I.. -o receiver receiver.cpp ../WireFormat.cpp
+ *   ./receiver [port] > motion.csv
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "WireFormat.h"
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// sequence tracking across sessions, so a window resent after a dropped session is not written twice.
+// anything well behind the last frame is taken to be a rebooted device rather than a resend
+static bool haveLast = false;
+static uint32_t lastSequence = 0;
+static bool duplicate = false;
+// the rows of the sequenced frame being decoded, held back until it is complete
+static std::string pending;
+static unsigned long pendingEntries = 0;
+
+static const bool
+isResend(const uint32_t sequence)
+{
+  return haveLast && WireFormat::sequenceAtOrBefore(sequence, lastSequence) && (lastSequence - sequence < 64);
+}
+
+static const bool
+acknowledge(const int session, WireDecoder &decoder, unsigned long &entries, unsigned long &duplicates)
+{
+  uint32_t sequence;
+
+  if (!decoder.frameDone(sequence))
+  {
+    return true;
+  }
+
+  if (duplicate)
+  {
+    duplicates++;
+    sequence = lastSequence;
+  }
+  else
+  {
+    fputs(pending.c_str(), stdout);
+    entries += pendingEntries;
+    haveLast = true;
+    lastSequence = sequence;
+  }
+  pending.clear();
+  pendingEntries = 0;
+
+  // persisted before acknowledging
+  fflush(stdout);
+  uint8_t ack[WireFormat::ackSize];
+  WireFormat::encodeAck(ack, sequence);
+
+  return write(session, ack, sizeof(ack)) == (ssize_t) sizeof(ack);
+}
+
+// consumes as much of buffer as forms complete csv lines or binary entries; returns bytes used, -1 on corrupt input
+static int
+consume(const int session, WireDecoder &decoder, const uint8_t *buffer, const size_t length, unsigned long &entries, unsigned long &duplicates)
+{
+  size_t used = 0;
+  char line[128];
+
+  while (used < length)
+  {
+    if ((decoder.remaining() == 0) && (buffer[used] != WireFormat::magic))
+    {
+      const uint8_t *end = (const uint8_t *) memchr(&buffer[used], '\n', length - used);
+      if (!end)
+      {
+	break;
+      }
+      fwrite(&buffer[used], 1, end - &buffer[used] + 1, stdout);
+      used = end - buffer + 1;
+      entries++;
+      continue;
+    }
+
+    MotionEntry entry;
+    bool decoded;
+    bool header = (decoder.remaining() == 0);
+    int consumed = decoder.next(&buffer[used], length - used, entry, decoded);
+    if (consumed <= 0)
+    {
+      return (consumed < 0) ? -1 : (int) used;
+    }
+    used += consumed;
+
+    uint32_t sequence;
+    if (header)
+    {
+      duplicate = decoder.sequenced(sequence) && isResend(sequence);
+      // whatever a torn frame left is resent from its start
+      pending.clear();
+      pendingEntries = 0;
+    }
+    if (decoded && !duplicate)
+    {
+      WireFormat::formatCsv(line, sizeof(line), entry);
+      if (decoder.sequenced(sequence))
+      {
+	pending += line;
+	pendingEntries++;
+      }
+      else
+      {
+	fputs(line, stdout);
+	entries++;
+      }
+    }
+    if (!acknowledge(session, decoder, entries, duplicates))
+    {
+      return -1;
+    }
+  }
+
+  return used;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const int port = (argc > 1) ? atoi(argv[1]) : 32768;
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  struct sockaddr_in address;
+
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if ((bind(listener, (struct sockaddr *) &address, sizeof(address)) < 0) || (listen(listener, 4) < 0))
+  {
+    perror("listen");
+    return 1;
+  }
+  fprintf(stderr, "listening on %d\n", port);
+
+  for (;;)
+  {
+    struct sockaddr_in peer;
+    socklen_t peerLength = sizeof(peer);
+    int session = accept(listener, (struct sockaddr *) &peer, &peerLength);
+
+    if (session < 0)
+    {
+      perror("accept");
+      continue;
+    }
+
+    WireDecoder decoder;
+    uint8_t buffer[8192];
+    size_t length = 0;
+    unsigned long bytes = 0;
+    unsigned long entries = 0;
+    unsigned long duplicates = 0;
+    double start = now();
+    ssize_t got;
+
+    fprintf(stderr, "session from %s:%d\n", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+    while ((got = read(session, &buffer[length], sizeof(buffer) - length)) > 0)
+    {
+      length += got;
+      bytes += got;
+
+      int used = consume(session, decoder, buffer, length, entries, duplicates);
+      if (used < 0)
+      {
+	fprintf(stderr, "corrupt stream after %lu bytes; dropping session\n", bytes);
+	break;
+      }
+      memmove(buffer, &buffer[used], length - used);
+      length -= used;
+    }
+    fflush(stdout);
+    close(session);
+    pending.clear();
+    pendingEntries = 0;
+
+    double elapsed = now() - start;
+    fprintf(stderr, "session closed: %lu entries, %lu bytes in %.1f s (%.1f entries/s, %.1f bytes/entry), %lu resent frames ignored%s\n",
+	    entries, bytes, elapsed, elapsed > 0 ? entries / elapsed : 0.0, entries ? (double) bytes / entries : 0.0, duplicates,
+	    length ? ", trailing partial entry discarded" : "");
+  }
+
+  return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * replay.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * replays a trace (see Trace.h, host/tracegen) through the firmware's own handlers on a virtual clock, as fast as the
+ * host can run them: each event goes through MotionTracker::motionDetected() or sampleStream() into the ring and the
+ * digest at its recorded time, while the main thread plays loop(), upload(hunk) then delay(loop ms), into a sink
+ * modelling the upload link.  time only passes in delay() and on the link, and events that fall due meanwhile are
+ * delivered there, as the isr and the streaming timer would preempt loop() on the device.  the timers themselves
+ * are not run: the trace is what they would have done.  reports sustained samples/s, fill() drops, the peak
+ * unsent backlog and upload latency (virtual time from the handler to the entry reaching the sink), overall and for
+ * interrupt samples, which have a lane of their own.  -o takes the link down for a stretch of the trace; -F gives
+ * the ring a flash log to spill to, in a file (see sim/SpiFlashSim.h).
+ * -p picks the ring's overflow policy; with a link too slow for the trace (-b) the report shows what each keeps:
+ * interrupt samples and streamed samples delivered, the longest stretch without a streamed sample and how stale the
+ * newest one is when the trace ends
+ *
+ *   make -C host replay
+ *   host/build/replay [-f csv|binary|acked] [-n hunk] [-l loop ms] [-b link bytes/s] [-w ms per write]
+ *                     [-o outage start s,length s] [-F flash file] [-p reject|oldest|decimate] trace
+ * the ring size is a build setting: make -C host clean && make -C host RING=512 replay
+ */
+
+#include <algorithm>
+#include <unistd.h>
+#include "MotionTracker.h"
+#include "Simulation.h"
+#include "Lis331Sim.h"
+#include "SpiFlashSim.h"
+#include "Trace.h"
+
+// stands in for the network: accepts everything at the link rate, decodes what arrives to time each entry's
+// delivery from its own stamp and tally what got through, and acknowledges sequenced frames straight away
+class ReplaySink : public UploadSink
+{
+public:
+  ReplaySink(const double bytesPerSecond, const uint32_t writeMicros)
+  : _bytesPerSecond(bytesPerSecond)
+  , _writeMicros(writeMicros)
+  , _epoch(0)
+  , _origin(0)
+  , _outageStart(0)
+  , _outageEnd(0)
+  , _open(false)
+  , _csv(false)
+  , _counted(false)
+  , _haveSequence(false)
+  , _lastSequence(0)
+  , _pending(0)
+  , _ackLength(0)
+  , _lineLength(0)
+  , _bytes(0)
+  , _writes(0)
+  , _entries(0)
+  , _interrupts(0)
+  , _lastStreamed(0)
+  , _streamGap(0)
+  {
+  }
+
+  virtual const bool open()
+  {
+    if (down())
+    {
+      return false;
+    }
+    _open = true;
+    _decoder.reset();
+    _pending = 0;
+    _ackLength = 0;
+    return true;
+  }
+
+  virtual void close() { _open = false; }
+  virtual const bool isOpen() { return _open; }
+
+  virtual const int write(const uint8_t *data, const size_t length)
+  {
+    // the bytes are on the far side once the link has carried them
+    if (down())
+    {
+      Simulation::advance(_writeMicros);
+      return -1;
+    }
+    Simulation::advance(_writeMicros + (uint64_t) (length * 1e6 / _bytesPerSecond));
+    _bytes += length;
+    _writes++;
+
+    if (_csv)
+    {
+      for (size_t i = 0; i < length; i++)
+      {
+	if (data[i] != '\n')
+	{
+	  _line[_lineLength] = data[i];
+	  _lineLength += (_lineLength < sizeof(_line) - 1);
+	  continue;
+	}
+	_line[_lineLength] = '\0';
+	_lineLength = 0;
+
+	struct tm calendar = {};
+	unsigned int micros;
+	MotionEntry entry;
+	if (sscanf(_line, "%d-%d-%dT%d:%d:%d.%uZ,%c", &calendar.tm_year, &calendar.tm_mon, &calendar.tm_mday,
+		   &calendar.tm_hour, &calendar.tm_min, &calendar.tm_sec, &micros, &entry._mode) == 8)
+	{
+	  calendar.tm_year -= 1900;
+	  calendar.tm_mon -= 1;
+	  entry._time = timegm(&calendar);
+	  entry._micros = micros;
+	  delivered(entry, true);
+	}
+      }
+      return length;
+    }
+
+    memcpy(&_buffer[_pending], data, length);
+    _pending += length;
+
+    size_t used = 0;
+    while (used < _pending)
+    {
+      MotionEntry entry;
+      bool decoded;
+      bool header = (_decoder.remaining() == 0);
+      int consumed = _decoder.next(&_buffer[used], _pending - used, entry, decoded);
+      if (consumed <= 0)
+      {
+	if (consumed < 0)
+	{
+	  fprintf(stderr, "corrupt upload stream\n");
+	  exit(1);
+	}
+	break;
+      }
+      used += consumed;
+
+      // resent frames carry entries that were already timed
+      uint32_t sequence;
+      if (header && _decoder.sequenced(sequence))
+      {
+	_counted = _haveSequence && WireFormat::sequenceAtOrBefore(sequence, _lastSequence);
+	_haveSequence = true;
+	_lastSequence = _counted ? _lastSequence : sequence;
+      }
+      if (decoded)
+      {
+	delivered(entry, !_counted);
+      }
+      if (_decoder.frameDone(sequence))
+      {
+	_ackLength = WireFormat::encodeAck(_ack, _lastSequence);
+	_counted = false;
+      }
+    }
+    memmove(_buffer, &_buffer[used], _pending - used);
+    _pending -= used;
+
+    return length;
+  }
+
+  virtual const int read(uint8_t *data, const size_t length)
+  {
+    size_t size = std::min(length, _ackLength);
+    memcpy(data, _ack, size);
+    memmove(_ack, &_ack[size], _ackLength - size);
+    _ackLength -= size;
+    return size;
+  }
+
+  void setCsv(const bool csv) { _csv = csv; }
+  // Time was set to 'epoch' at virtual time 'origin'
+  void setOrigin(const time_t epoch, const uint64_t origin) { _epoch = epoch; _origin = origin; }
+  void setOutage(const uint64_t start, const uint64_t end) { _outageStart = start; _outageEnd = end; }
+  const bool down() const { return (Simulation::now() >= _outageStart) && (Simulation::now() < _outageEnd); }
+
+  std::vector<uint64_t> _latencies;
+  std::vector<uint64_t> _interruptLatencies;
+  const double _bytesPerSecond;
+  const uint32_t _writeMicros;
+  time_t _epoch;
+  uint64_t _origin;
+  uint64_t _outageStart;
+  uint64_t _outageEnd;
+  bool _open;
+  bool _csv;
+  bool _counted;
+  bool _haveSequence;
+  uint32_t _lastSequence;
+  WireDecoder _decoder;
+  uint8_t _buffer[2 * NETWORK_STAGING_BYTES];
+  size_t _pending;
+  uint8_t _ack[WireFormat::ackSize];
+  size_t _ackLength;
+  char _line[128];
+  size_t _lineLength;
+  uint64_t _bytes;
+  uint64_t _writes;
+  uint64_t _entries;
+  uint64_t _interrupts;
+  uint64_t _lastStreamed;
+  uint64_t _streamGap;	// the longest stretch of the trace with no streamed sample delivered
+
+private:
+  void delivered(const MotionEntry &entry, const bool first)
+  {
+    if (!first)
+    {
+      return;
+    }
+
+    // the entry was stamped in virtual time; entries come out in the order they were stamped
+    uint64_t stamped = _origin + (uint64_t) (entry._time - _epoch) * 1000000 + entry._micros;
+    _latencies.push_back(Simulation::now() - stamped);
+    _entries++;
+    if (entry._mode == 'i')
+    {
+      _interruptLatencies.push_back(Simulation::now() - stamped);
+      _interrupts++;
+    }
+    else
+    {
+      _streamGap = std::max(_streamGap, stamped - std::min(stamped, _lastStreamed));
+      _lastStreamed = stamped;
+    }
+  }
+};
+
+static const uint64_t
+percentile(std::vector<uint64_t> &sorted, const double fraction)
+{
+  return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, (size_t) (fraction * sorted.size()))];
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *format = "binary";
+  int hunk = 128;
+  unsigned int loopMillis = 1000;
+  double linkRate = 50000;
+  double writeMillis = 2;
+  bool verbose = false;
+  double outageStart = 0;
+  double outageLength = 0;
+  const char *flash = NULL;
+  const char *policy = "reject";
+  int option;
+
+  while ((option = getopt(argc, argv, "f:n:l:b:w:vo:F:p:")) != -1)
+  {
+    switch (option)
+    {
+      case 'f': format = optarg; break;
+      case 'n': hunk = atoi(optarg); break;
+      case 'l': loopMillis = atoi(optarg); break;
+      case 'b': linkRate = atof(optarg); break;
+      case 'w': writeMillis = atof(optarg); break;
+      case 'v': verbose = true; break;
+      case 'o': sscanf(optarg, "%lf,%lf", &outageStart, &outageLength); break;
+      case 'F': flash = optarg; break;
+      case 'p': policy = optarg; break;
+      default:
+	optind = argc;
+	break;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    fprintf(stderr, "usage: %s [-f csv|binary|acked] [-n hunk] [-l loop ms] [-b link bytes/s] [-w ms per write] [-o outage start s,length s] [-F flash file] [-p reject|oldest|decimate] [-v] trace\n", argv[0]);
+    return 1;
+  }
+
+  FILE *in = fopen(argv[optind], "r");
+  std::vector<TraceEvent> events;
+  time_t epoch;
+  if (!in || !Trace::read(in, events, epoch))
+  {
+    fprintf(stderr, "cannot read trace %s\n", argv[optind]);
+    return 1;
+  }
+  fclose(in);
+
+  // the ring's complaints about every dropped entry would swamp the report; -v brings them back
+  Log._level = verbose ? LOG_LEVEL_INFO : LOG_LEVEL_NONE;
+
+  Lis331Sim accelerometer(SS, A1);
+  MotionTracker *tracker = new MotionTracker(A1);
+  ReplaySink sink(linkRate, writeMillis * 1000);
+  size_t next = 0;
+  size_t interrupts = 0;
+  int32_t peak = 0;
+  uint32_t peakSpilled = 0;
+  uint64_t previous = 0;
+  bool replaying = true;
+
+  Simulation::shutdown();
+  Simulation::useVirtualClock([&](const uint64_t now)
+  {
+    // the worker thread would read the sample clock at least this often; it must see every wrap of the cycle counter
+    (void) tracker->_clock.now();
+    while (replaying && (next < events.size()) && (events[next]._micros <= now))
+    {
+      const TraceEvent &event = events[next++];
+
+      // at the event's own time, so the sample clock stamps it as the device would
+      if (event._micros > Simulation::now())
+      {
+	Simulation::advance(event._micros - Simulation::now());
+      }
+
+      // the sensor runs at 400 Hz, faster than the handlers read it, so every read finds overrun data (which is
+      // what xyzReady() checks for)
+      accelerometer.inject(event._x, event._y, event._z, std::max<uint64_t>(2, (event._micros - previous) / 2500));
+      previous = event._micros;
+      if (event._kind == 'i')
+      {
+	// the isr, then its bottom half straight away, as the worker thread (not started here) would
+	tracker->motionDetected();
+	tracker->processMotion();
+	interrupts++;
+      }
+      else
+      {
+	tracker->sampleStream();
+      }
+      peak = std::max<int32_t>(peak, tracker->_ring.spaceLeft());
+      peakSpilled = std::max<uint32_t>(peakSpilled, tracker->_ring.spilled());
+    }
+  });
+  Time.setTime(epoch);
+  sink.setOrigin(epoch, Simulation::now());
+
+  tracker->accelerometer.begin(SS);
+  tracker->_ring.setIdentity("replay");
+  tracker->_ring.setFormat(!strcmp(format, "csv") ? NetworkRingBuffer::csv : !strcmp(format, "acked") ? NetworkRingBuffer::acknowledged : NetworkRingBuffer::binary);
+  tracker->_ring.setSink(&sink);
+  sink.setCsv(!strcmp(format, "csv"));
+  tracker->_ring.setOverflow(!strcmp(policy, "oldest") ? NetworkRingBuffer::dropOldest : !strcmp(policy, "decimate") ? NetworkRingBuffer::decimate : NetworkRingBuffer::rejectNewest);
+  sink.setOutage(outageStart * 1e6, (outageStart + outageLength) * 1e6);
+
+  // a blank part each run, on the board's chip select
+  SpiFlashSim *flashSim = flash ? new SpiFlashSim(FLASH_CHIP_SELECT, flash, FLASH_LOG_START + FLASH_LOG_SECTORS * SpiFlashSim::sectorSize, true) : NULL;
+  if (flashSim && flashSim->isOpen())
+  {
+    tracker->beginSpill();
+  }
+
+  struct timespec started, finished;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  while (next < events.size())
+  {
+    (void) tracker->upload(hunk);
+    delay(loopMillis);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finished);
+
+  // entries still buffered when the trace ends have no meaningful latency
+  replaying = false;
+  uint32_t dropped = tracker->_ring.dropped();
+  uint32_t thinned = tracker->_ring.thinned();
+  uint64_t buffered = events.size() - dropped - thinned - sink._entries;
+  double traceSeconds = events.empty() ? 0 : events.back()._micros / 1e6;
+  double wall = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+  std::vector<uint64_t> &latencies = sink._latencies;
+  std::vector<uint64_t> &interruptLatencies = sink._interruptLatencies;
+  std::sort(latencies.begin(), latencies.end());
+  std::sort(interruptLatencies.begin(), interruptLatencies.end());
+
+  printf("trace: %.0f s, %zu events (%zu interrupts, %zu streamed)\n", traceSeconds, events.size(), interrupts, events.size() - interrupts);
+  printf("ring %u entries, upload(%d) every %u ms, %s over %.0f B/s + %.1f ms/write\n",
+	 NETWORK_RING_ENTRIES, hunk, loopMillis, format, linkRate, writeMillis);
+  printf("replayed in %.2f s (%.0fx real time), %.0f samples/s sustained\n", wall, traceSeconds / wall, events.size() / wall);
+  printf("dropped %u (%.2f%%), peak unsent backlog %d of %u\n", dropped, events.empty() ? 0 : 100.0 * dropped / events.size(), peak, NETWORK_RING_ENTRIES);
+  printf("overflow %s: thinned %u streamed; delivered %" PRIu64 " of %zu interrupts, %" PRIu64 " streamed; longest stream gap %.1f s, newest %.1f s old at the end\n",
+	 policy, thinned, sink._interrupts, interrupts, sink._entries - sink._interrupts, sink._streamGap / 1e6,
+	 (Simulation::now() - std::min(Simulation::now(), sink._lastStreamed)) / 1e6);
+  if (outageLength > 0)
+  {
+    printf("link down from %.0f s for %.0f s; peak spilled to flash %u entries\n", outageStart, outageLength, peakSpilled);
+  }
+  printf("uploaded %" PRIu64 " entries in %" PRIu64 " writes, %" PRIu64 " bytes (%.1f bytes/entry), %" PRIu64 " left buffered\n",
+	 sink._entries, sink._writes, sink._bytes, sink._entries ? (double) sink._bytes / sink._entries : 0.0, buffered);
+  printf("upload latency ms: p50 %.0f p90 %.0f p99 %.0f max %.0f\n", percentile(latencies, 0.5) / 1e3, percentile(latencies, 0.9) / 1e3,
+	 percentile(latencies, 0.99) / 1e3, latencies.empty() ? 0 : latencies.back() / 1e3);
+  printf("  interrupts only: p50 %.0f p90 %.0f p99 %.0f max %.0f\n", percentile(interruptLatencies, 0.5) / 1e3,
+	 percentile(interruptLatencies, 0.9) / 1e3, percentile(interruptLatencies, 0.99) / 1e3,
+	 interruptLatencies.empty() ? 0 : interruptLatencies.back() / 1e3);
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * ringstress.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * runs the ring's producer and consumer on separate threads and reports throughput, lost entries and
+ * any ordering/corruption the consumer observes.  by default a full ring makes the producer retry, which measures
+ * handoff throughput; with 'drop' it discards like fill() does from the isr, which measures loss
+ *
+ *   g++ -O2 -pthread -I.. -o ringstress ringstress.cpp
+ *   ./ringstress [entries] [hunk] [drop]
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include "MotionEntry.h"
+#include "RingBuffer.h"
+
+int
+main(int argc, char *argv[])
+{
+  const uint32_t total = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+  const uint32_t hunk = (argc > 2) ? strtoul(argv[2], NULL, 0) : 128;
+  const bool drop = (argc > 3) && !strcmp(argv[3], "drop");
+  static RingBuffer<MotionEntry, 512> ring;
+  std::atomic<bool> producing(true);
+  uint32_t lost = 0;
+  uint32_t received = 0;
+  uint32_t corrupt = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread producer([&]()
+  {
+    for (uint32_t i = 0; i < total; i++)
+    {
+      // sequence number in the timestamp, axes derived from it so torn copies are detectable
+      MotionEntry entry(i, 's', (int16_t) i, (int16_t) ~i, (int16_t) (i * 3));
+      while (!ring.push(entry))
+      {
+	if (drop)
+	{
+	  lost++;
+	  break;
+	}
+	std::this_thread::yield();
+      }
+    }
+    producing = false;
+  });
+
+  std::thread consumer([&]()
+  {
+    time_t previous = -1;
+
+    while (producing || ring.size())
+    {
+      uint32_t available = ring.size();
+      uint32_t count = (available < hunk) ? available : hunk;
+
+      if (!count)
+      {
+	std::this_thread::yield();
+	continue;
+      }
+
+      for (uint32_t i = 0; i < count; i++)
+      {
+	const MotionEntry &entry = ring.peek(i);
+	uint32_t sequence = entry._time;
+
+	if ((entry._time <= previous) || (entry._x != (int16_t) sequence) || (entry._y != (int16_t) ~sequence) || (entry._z != (int16_t) (sequence * 3)))
+	{
+	  corrupt++;
+	}
+	previous = entry._time;
+      }
+      ring.pop(count);
+      received += count;
+    }
+  });
+
+  producer.join();
+  consumer.join();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("produced %u, received %u, lost %u (%.2f%%), corrupt %u\n", total, received, lost, 100.0 * lost / total, corrupt);
+  printf("%.2f s, %.1f M push/s, %.1f M pop/s\n", seconds, total / seconds / 1e6, received / seconds / 1e6);
+
+  return (corrupt || (received + lost != total)) ? 1 : 0;
+}
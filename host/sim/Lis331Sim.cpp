@@ -0,0 +1,282 @@
+/*
+ * Lis331Sim.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <chrono>
+#include <math.h>
+#include "Lis331Sim.h"
+
+#define WHO_AM_I	0x0F
+#define CTRL_REG1	0x20
+#define CTRL_REG2	0x21
+#define CTRL_REG3	0x22
+#define CTRL_REG4	0x23
+#define STATUS_REG	0x27
+#define OUT_X_L		0x28
+#define OUT_Z_H		0x2D
+#define INT1_CFG	0x30
+#define INT1_SOURCE	0x31
+#define INT1_THS	0x32
+
+Lis331Sim::Lis331Sim (const uint16_t chipSelect, const uint16_t interruptPin)
+: _chipSelect(chipSelect)
+, _interruptPin(interruptPin)
+, _shakeUntil(0)
+, _running(false)
+, _unread(0)
+, _interrupt(false)
+, _cleared(false)
+, _command(false)
+, _reading(false)
+, _increment(false)
+, _address(0)
+, _seed(1)
+{
+  memset(_registers, 0, sizeof(_registers));
+  _registers[WHO_AM_I] = 0x32;
+  _registers[CTRL_REG1] = 0x07;	// power down, axes enabled
+  memset(_latest, 0, sizeof(_latest));
+  _lowPass[0] = _lowPass[1] = 0;
+  _lowPass[2] = 1;
+  _source = std::bind(&Lis331Sim::restSource, this, std::placeholders::_1, std::placeholders::_2);
+  Simulation::attachSpi(chipSelect, this);
+}
+
+Lis331Sim::~Lis331Sim ()
+{
+  stop();
+  Simulation::attachSpi(_chipSelect, NULL);
+}
+
+void
+Lis331Sim::start()
+{
+  if (!_running.exchange(true))
+  {
+    _thread = std::thread(&Lis331Sim::run, this);
+  }
+}
+
+void
+Lis331Sim::stop()
+{
+  if (_running.exchange(false))
+  {
+    _thread.join();
+  }
+}
+
+void
+Lis331Sim::setSource(Source source)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _source = source;
+}
+
+void
+Lis331Sim::shake(const double seconds)
+{
+  _shakeUntil = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() + seconds;
+}
+
+void
+Lis331Sim::restSource(const double seconds, float g[3])
+{
+  double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  bool shaking = now < _shakeUntil;
+
+  for (int axis = 0; axis < 3; axis++)
+  {
+    _seed = _seed * 1103515245 + 12345;
+    g[axis] = ((int) ((_seed >> 16) & 0xFF) - 128) / 128.0 * 0.01;	// +/- 10 mg
+  }
+  g[2] += 1;
+  if (shaking)
+  {
+    g[0] += 0.6 * sin(2 * M_PI * 3 * seconds);
+    g[1] += 0.4 * cos(2 * M_PI * 5 * seconds);
+  }
+}
+
+void
+Lis331Sim::inject(const int16_t x, const int16_t y, const int16_t z, const uint32_t produced)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _latest[0] = x;
+  _latest[1] = y;
+  _latest[2] = z;
+  _unread += produced;
+}
+
+const double
+Lis331Sim::sampleRate() const
+{
+  static const double normal[] = { 50, 100, 400, 1000 };
+  static const double lowPower[] = { 0.5, 1, 2, 5, 10, 10 };
+  uint8_t power = _registers[CTRL_REG1] >> 5;
+
+  // power mode 0 is power down, 1 normal at the data rate bits, 2 and up the low power rates
+  return (power == 1) ? normal[(_registers[CTRL_REG1] >> 3) & 0x3] : (power > 1) ? lowPower[power - 2] : 0;
+}
+
+const float
+Lis331Sim::fullScale() const
+{
+  static const float scale[] = { 6, 12, 12, 24 };
+
+  return scale[(_registers[CTRL_REG4] >> 4) & 0x3];
+}
+
+void
+Lis331Sim::run()
+{
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point next = begin;
+
+  while (_running)
+  {
+    double rate;
+    bool line;
+    bool cleared;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      cleared = _cleared;
+      _cleared = false;
+      rate = sampleRate();
+      if (rate > 0)
+      {
+	sample(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+      }
+      line = _interrupt;
+    }
+
+    // outside the register lock, since the isr reads registers.  a latch cleared since the last sample still
+    // pulsed the line low, even if this sample latched it again
+    if (cleared)
+    {
+      Simulation::setPin(_interruptPin, LOW);
+    }
+    Simulation::setPin(_interruptPin, line ? HIGH : LOW);
+
+    next += std::chrono::microseconds((rate > 0) ? (int64_t) (1e6 / rate) : 100000);
+    if (next < std::chrono::steady_clock::now())
+    {
+      next = std::chrono::steady_clock::now();
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void
+Lis331Sim::sample(const double seconds)
+{
+  float g[3];
+  float scale = fullScale();
+  float threshold = (_registers[INT1_THS] & 0x7F) * scale / 128;
+  uint8_t config = _registers[INT1_CFG];
+  uint8_t events = 0;
+  uint8_t enabled = 0;
+
+  _source(seconds, g);
+  for (int axis = 0; axis < 3; axis++)
+  {
+    float counts = g[axis] / scale * 32768;
+    counts = (counts > 32767) ? 32767 : (counts < -32768) ? -32768 : counts;
+    _latest[axis] = ((int16_t) counts) & ~0xF;
+
+    // the interrupt sees the high-passed signal when CTRL_REG2 routes the filter to it
+    _lowPass[axis] += (g[axis] - _lowPass[axis]) * 0.02;
+    float level = fabs((_registers[CTRL_REG2] & 0x04) ? g[axis] - _lowPass[axis] : g[axis]);
+    uint8_t low = 1 << (axis * 2);
+    uint8_t high = low << 1;
+    events |= (level > threshold) ? high : low;
+    enabled |= config & (low | high);
+  }
+  _unread++;
+
+  bool active = enabled && ((config & 0x80) ? ((events & enabled) == enabled) : (events & enabled));
+  bool latch = _registers[CTRL_REG3] & 0x04;
+  if (active)
+  {
+    _registers[INT1_SOURCE] = 0x40 | (events & enabled);
+    _interrupt = true;
+  }
+  else if (!latch)
+  {
+    _registers[INT1_SOURCE] = 0;
+    _interrupt = false;
+  }
+}
+
+void
+Lis331Sim::select()
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _command = true;
+}
+
+const uint8_t
+Lis331Sim::transfer(const uint8_t data)
+{
+  std::lock_guard<std::mutex> guard(_lock);
+
+  if (_command)
+  {
+    // first byte: read bit, auto-increment bit, six address bits
+    _command = false;
+    _reading = data & 0x80;
+    _increment = data & 0x40;
+    _address = data & 0x3F;
+    return 0xFF;
+  }
+
+  uint8_t value = 0;
+  uint8_t address = _address;
+  if (_reading)
+  {
+    if ((address >= OUT_X_L) && (address <= OUT_Z_H))
+    {
+      value = _latest[(address - OUT_X_L) / 2] >> ((address & 1) ? 8 : 0);
+      if (address == OUT_Z_H)
+      {
+	_unread = 0;
+      }
+    }
+    else if (address == STATUS_REG)
+    {
+      value = (_unread > 0 ? 0x0F : 0) | (_unread > 1 ? 0xF0 : 0);
+    }
+    else
+    {
+      value = _registers[address];
+      if (address == INT1_SOURCE)
+      {
+	// reading the source clears a latched interrupt
+	_registers[INT1_SOURCE] = 0;
+	_cleared = _interrupt;
+	_interrupt = false;
+      }
+    }
+  }
+  else if ((address != WHO_AM_I) && (address != STATUS_REG) && (address != INT1_SOURCE))
+  {
+    _registers[address] = data;
+  }
+
+  if (_increment)
+  {
+    _address = (_address + 1) & 0x3F;
+  }
+
+  return value;
+}
+
+void
+Lis331Sim::deselect()
+{
+  std::lock_guard<std::mutex> guard(_lock);
+  _command = false;
+}
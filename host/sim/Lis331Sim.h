@@ -0,0 +1,70 @@
+/*
+ * Lis331Sim.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Simulation.h"
+
+// register-level model of the LIS331HH behind the spi bus: samples at the configured output data rate, left-justified
+// 12-bit outputs at the configured full scale, status bits for new/overrun data, and a high-passed INT1 threshold
+// interrupt (OR/AND of the enabled axes, optionally latched until INT1_SOURCE is read) on the wired pin
+class Lis331Sim : public SpiDevice
+{
+public:
+  // acceleration in g at the given time since start
+  typedef std::function<void(const double seconds, float g[3])> Source;
+
+  Lis331Sim (const uint16_t chipSelect, const uint16_t interruptPin);
+  virtual ~Lis331Sim ();
+
+  void start();
+  void stop();
+
+  // replaces the default source: at rest, z up, with a little noise and any requested shaking
+  void setSource(Source source);
+  void shake(const double seconds);
+  // for replays that leave the sampling thread stopped: latch a sample as if the sensor had produced 'produced'
+  // samples since the last read (more than one sets the overrun bits, as polling slower than the data rate does)
+  void inject(const int16_t x, const int16_t y, const int16_t z, const uint32_t produced = 1);
+
+  virtual void select();
+  virtual const uint8_t transfer(const uint8_t data);
+  virtual void deselect();
+
+protected:
+  void run();
+  void sample(const double seconds);
+  const double sampleRate() const;
+  const float fullScale() const;
+  void restSource(const double seconds, float g[3]);
+
+  uint16_t _chipSelect;
+  uint16_t _interruptPin;
+  Source _source;
+  std::atomic<double> _shakeUntil;
+  std::mutex _lock;
+  std::thread _thread;
+  std::atomic<bool> _running;
+
+  uint8_t _registers[0x40];
+  int16_t _latest[3];
+  float _lowPass[3];
+  uint32_t _unread;
+  bool _interrupt;
+  bool _cleared;
+
+  // the spi transaction in progress
+  bool _command;
+  bool _reading;
+  bool _increment;
+  uint8_t _address;
+  uint32_t _seed;
+};
@@ -0,0 +1,1045 @@
+/*
+ * Particle.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <random>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Simulation.h"
+
+SPIClass SPI;
+TimeClass Time;
+Logger Log;
+SerialClass Serial;
+SystemClass System;
+ParticleClass Particle;
+WiFiClass WiFi;
+RGBClass RGB;
+
+static FlashRegisters flashRegisters;
+FlashRegisters *FLASH = &flashRegisters;
+
+static const int pins = 32;
+static std::atomic<uint8_t> levels[pins];
+static std::atomic<uint32_t> risingEdges[pins];
+static InterruptMode interruptModes[pins];
+static std::function<void()> interruptHandlers[pins];
+static SpiDevice *spiDevices[pins];
+static std::atomic<SpiDevice *> selected(NULL);
+static std::mutex gpioLock;
+
+static std::string deviceId("0123456789abcdef01234567");
+static std::atomic<bool> virtualClock(false);
+static std::atomic<uint64_t> virtualMicros(0);
+static std::function<void(const uint64_t)> onAdvance;
+static bool advancing = false;
+static std::map<std::string, std::function<int(String)> > functions;
+static std::function<bool(const char *, const char *)> publishHook;
+static int64_t cloudOffset;	// what the cloud sets the rtc to after a cold boot
+
+// function-local statics so timers in other translation units' globals can use them during static construction
+static std::recursive_mutex &
+interrupts()
+{
+  static std::recursive_mutex lock;
+  return lock;
+}
+
+static std::mutex &
+outputLock()
+{
+  static std::mutex lock;
+  return lock;
+}
+
+static const std::chrono::steady_clock::time_point &
+boot()
+{
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return start;
+}
+
+static const uint64_t
+elapsedMicros()
+{
+  if (virtualClock)
+  {
+    return virtualMicros;
+  }
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot()).count();
+}
+
+static const time_t
+currentSeconds()
+{
+  return virtualClock ? (time_t) (virtualMicros / 1000000) : time(NULL);
+}
+
+static void
+output(const char *line)
+{
+  std::lock_guard<std::mutex> guard(outputLock());
+
+  fputs(line, stdout);
+  fflush(stdout);
+}
+
+// the end of the simulated device: flush what it said, and skip destructors that would race the other threads
+static void
+powerOff(const int status)
+{
+  fflush(stdout);
+  fflush(stderr);
+  _exit(status);
+}
+
+void
+lockInterrupts()
+{
+  interrupts().lock();
+}
+
+void
+unlockInterrupts()
+{
+  interrupts().unlock();
+}
+
+// gpio
+
+void
+pinMode(const uint16_t pin, const PinMode mode)
+{
+}
+
+void
+digitalWrite(const uint16_t pin, const uint8_t value)
+{
+  if (pin >= pins)
+  {
+    return;
+  }
+
+  levels[pin] = value;
+  if (spiDevices[pin])
+  {
+    if (value == LOW)
+    {
+      selected = spiDevices[pin];
+      spiDevices[pin]->select();
+    }
+    else
+    {
+      spiDevices[pin]->deselect();
+      selected = NULL;
+    }
+  }
+}
+
+const int32_t
+digitalRead(const uint16_t pin)
+{
+  return (pin < pins) ? levels[pin].load() : LOW;
+}
+
+const bool
+attachInterrupt(const uint16_t pin, std::function<void()> handler, const InterruptMode mode)
+{
+  if (pin >= pins)
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(gpioLock);
+  interruptHandlers[pin] = handler;
+  interruptModes[pin] = mode;
+
+  return true;
+}
+
+void
+detachInterrupt(const uint16_t pin)
+{
+  if (pin < pins)
+  {
+    std::lock_guard<std::mutex> guard(gpioLock);
+    interruptHandlers[pin] = NULL;
+  }
+}
+
+// spi
+
+void
+SPIClass::begin()
+{
+}
+
+void
+SPIClass::setDataMode(const uint8_t mode)
+{
+}
+
+void
+SPIClass::setBitOrder(const uint8_t order)
+{
+}
+
+const uint8_t
+SPIClass::transfer(const uint8_t data)
+{
+  SpiDevice *device = selected;
+
+  // nothing selected reads as a floating bus
+  return device ? device->transfer(data) : 0xFF;
+}
+
+// timing
+
+const system_tick_t
+millis()
+{
+  return elapsedMicros() / 1000;
+}
+
+const system_tick_t
+micros()
+{
+  return elapsedMicros();
+}
+
+void
+delay(const system_tick_t milliseconds)
+{
+  if (virtualClock)
+  {
+    Simulation::advance(milliseconds * 1000ULL);
+    return;
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+void
+delayMicroseconds(const unsigned int microseconds)
+{
+  if (virtualClock)
+  {
+    Simulation::advance(microseconds);
+    return;
+  }
+
+  std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+}
+
+// the FreeRTOS timer daemon: one thread, callbacks run one at a time in expiry order
+class TimerDaemon
+{
+public:
+  static TimerDaemon &instance()
+  {
+    // never destroyed; Timers in static storage outlive any ordinary destruction order
+    static TimerDaemon *daemon = new TimerDaemon();
+    return *daemon;
+  }
+
+  void add(Timer *timer)
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _timers.push_back(timer);
+    if (!_thread.joinable() && !_stopped)
+    {
+      _thread = std::thread(&TimerDaemon::run, this);
+    }
+  }
+
+  void remove(Timer *timer)
+  {
+    std::unique_lock<std::mutex> guard(_lock);
+    // let a running callback finish unless it is the one disposing of its own timer
+    while ((_running == timer) && (std::this_thread::get_id() != _thread.get_id()))
+    {
+      _idle.wait(guard);
+    }
+    for (std::vector<Timer *>::iterator i = _timers.begin(); i != _timers.end(); ++i)
+    {
+      if (*i == timer)
+      {
+	_timers.erase(i);
+	break;
+      }
+    }
+  }
+
+  void arm(Timer *timer, const bool active)
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    timer->_active = active;
+    timer->_due = elapsedMicros() / 1000 + timer->_period;
+    _wake.notify_one();
+  }
+
+  void setPeriod(Timer *timer, const unsigned int period)
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    timer->_period = period;
+  }
+
+  const bool isActive(const Timer *timer)
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    return timer->_active;
+  }
+
+  void stop()
+  {
+    std::unique_lock<std::mutex> guard(_lock);
+    _stopped = true;
+    _wake.notify_one();
+    if (_thread.joinable() && (std::this_thread::get_id() != _thread.get_id()))
+    {
+      guard.unlock();
+      _thread.join();
+    }
+  }
+
+private:
+  TimerDaemon()
+  : _running(NULL)
+  , _stopped(false)
+  {
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> guard(_lock);
+
+    while (!_stopped)
+    {
+      Timer *next = NULL;
+      for (std::vector<Timer *>::iterator i = _timers.begin(); i != _timers.end(); ++i)
+      {
+	if ((*i)->_active && (!next || ((*i)->_due < next->_due)))
+	{
+	  next = *i;
+	}
+      }
+      if (!next)
+      {
+	_wake.wait(guard);
+	continue;
+      }
+
+      uint64_t now = elapsedMicros() / 1000;
+      if (next->_due > now)
+      {
+	_wake.wait_for(guard, std::chrono::milliseconds(next->_due - now));
+	continue;
+      }
+
+      if (next->_oneShot)
+      {
+	next->_active = false;
+      }
+      else
+      {
+	next->_due = now + next->_period;
+      }
+      Timer::timer_callback_fn callback = next->_callback;
+      _running = next;
+      guard.unlock();
+      callback();
+      guard.lock();
+      _running = NULL;
+      _idle.notify_all();
+    }
+  }
+
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::condition_variable _idle;
+  std::vector<Timer *> _timers;
+  std::thread _thread;
+  Timer *_running;
+  bool _stopped;
+};
+
+Timer::Timer(const unsigned int period, timer_callback_fn callback, const bool oneShot)
+: _callback(callback)
+, _period(period)
+, _oneShot(oneShot)
+, _active(false)
+, _due(0)
+{
+  TimerDaemon::instance().add(this);
+}
+
+Timer::~Timer()
+{
+  dispose();
+}
+
+void
+Timer::start()
+{
+  TimerDaemon::instance().arm(this, true);
+}
+
+void
+Timer::stop()
+{
+  TimerDaemon::instance().arm(this, false);
+}
+
+void
+Timer::reset()
+{
+  start();
+}
+
+void
+Timer::changePeriod(const unsigned int period)
+{
+  // as on the device, a new period also (re)starts the timer
+  TimerDaemon::instance().setPeriod(this, period);
+  start();
+}
+
+const bool
+Timer::isActive() const
+{
+  return TimerDaemon::instance().isActive(this);
+}
+
+void
+Timer::dispose()
+{
+  TimerDaemon::instance().remove(this);
+}
+
+// threads
+
+Thread::Thread(const char *name, std::function<void()> function, const os_thread_prio_t priority, const size_t stackSize)
+{
+  std::thread(function).detach();
+}
+
+// time
+
+TimeClass::TimeClass()
+: _offset(0)
+, _valid(true)
+{
+}
+
+const time_t
+TimeClass::now() const
+{
+  return currentSeconds() + _offset;
+}
+
+void
+TimeClass::setTime(const time_t when)
+{
+  _offset = when - currentSeconds();
+  _valid = true;
+}
+
+const bool
+TimeClass::isValid() const
+{
+  return _valid && (now() > 0);
+}
+
+static struct tm
+broken(const time_t when)
+{
+  struct tm parts;
+
+  gmtime_r(&when, &parts);
+
+  return parts;
+}
+
+const int
+TimeClass::hour(const time_t when) const
+{
+  return broken(when).tm_hour;
+}
+
+const int
+TimeClass::minute(const time_t when) const
+{
+  return broken(when).tm_min;
+}
+
+const int
+TimeClass::second(const time_t when) const
+{
+  return broken(when).tm_sec;
+}
+
+const int
+TimeClass::day(const time_t when) const
+{
+  return broken(when).tm_mday;
+}
+
+const int
+TimeClass::month(const time_t when) const
+{
+  return broken(when).tm_mon + 1;
+}
+
+const int
+TimeClass::year(const time_t when) const
+{
+  return broken(when).tm_year + 1900;
+}
+
+const int
+TimeClass::year() const
+{
+  return year(now());
+}
+
+String
+TimeClass::format(const time_t when, const char *format) const
+{
+  // Device OS writes a zero zone offset as 'Z'
+  std::string pattern(format);
+  for (size_t zone; (zone = pattern.find("%z")) != std::string::npos; )
+  {
+    pattern.replace(zone, 2, "Z");
+  }
+
+  char text[64];
+  struct tm parts = broken(when);
+  strftime(text, sizeof(text), pattern.c_str(), &parts);
+
+  return String(text);
+}
+
+// logging
+
+void
+Logger::log(const int level, const char *format, ...) const
+{
+  if (!isLevelEnabled(level))
+  {
+    return;
+  }
+
+  const char *name = (level >= LOG_LEVEL_ERROR) ? "ERROR" : (level >= LOG_LEVEL_WARN) ? "WARN" : (level >= LOG_LEVEL_INFO) ? "INFO" : "TRACE";
+  char message[512];
+  va_list arguments;
+  va_start(arguments, format);
+  vsnprintf(message, sizeof(message), format, arguments);
+  va_end(arguments);
+
+  char line[600];
+  snprintf(line, sizeof(line), "%010u [app] %s: %s\n", millis(), name, message);
+  output(line);
+}
+
+SerialLogHandler::SerialLogHandler(const LogLevel level)
+{
+  Log._level = level;
+}
+
+void
+SerialClass::begin(const int baud)
+{
+}
+
+void
+SerialClass::flush()
+{
+  fflush(stdout);
+}
+
+void
+SerialClass::print(const char *text)
+{
+  output(text);
+}
+
+void
+SerialClass::println(const char *text)
+{
+  std::string line(text);
+  line += "\n";
+  output(line.c_str());
+}
+
+void
+SerialClass::println(const int value, const int base)
+{
+  char line[16];
+  snprintf(line, sizeof(line), (base == HEX) ? "%X\n" : "%d\n", value);
+  output(line);
+}
+
+// system
+
+void
+SystemClass::on(const system_event_t events, event_handler_t handler)
+{
+  _events = events;
+  _handler = handler;
+}
+
+void
+SystemClass::enableFeature(const int feature)
+{
+}
+
+String
+SystemClass::deviceID() const
+{
+  return String(deviceId);
+}
+
+const uint32_t
+SystemClass::ticks() const
+{
+  return elapsedMicros() * ticksPerMicrosecond();
+}
+
+const uint32_t
+SystemClass::ticksPerMicrosecond() const
+{
+  // the photon's 120 MHz cycle counter
+  return 120;
+}
+
+void
+SystemClass::reset()
+{
+  Log.error("system reset requested; simulation ends");
+  powerOff(2);
+}
+
+void
+SystemClass::sleep(const int mode, const long seconds)
+{
+  // waking from deep sleep is a reboot, which a process cannot do to itself
+  Log.info("deep sleep for %ld s; simulation ends", seconds);
+  powerOff(0);
+}
+
+void
+SystemClass::sleep(const uint16_t wakeUpPin, const InterruptMode edgeTriggerMode)
+{
+  // stop mode: execution resumes here after the wake-up edge
+  uint32_t edges = risingEdges[wakeUpPin];
+
+  Log.info("stop mode sleep until pin %u rises", wakeUpPin);
+  while (risingEdges[wakeUpPin] == edges)
+  {
+    delay(10);
+  }
+}
+
+uint32_t
+HAL_RNG_GetRandomNumber()
+{
+  static std::random_device source;
+
+  return source();
+}
+
+// the cloud
+
+void
+ParticleClass::connect()
+{
+  if (!_connected)
+  {
+    _connected = true;
+    Log.info("cloud connected");
+  }
+  if (!Time._valid)
+  {
+    Time._offset = cloudOffset;
+    Time._valid = true;
+    Log.info("rtc set from the cloud");
+  }
+}
+
+void
+ParticleClass::disconnect()
+{
+  _connected = false;
+  Log.info("cloud disconnected");
+}
+
+const bool
+ParticleClass::publish(const char *name, const char *data)
+{
+  // Device OS 0.6 limits; the cloud also allows a burst of 4 then 1 per second, and silently drops the excess
+  static double tokens = 4;
+  static system_tick_t refilled = 0;
+
+  if (!_connected || (strlen(name) > 63) || (strlen(data) > 255))
+  {
+    Log.warn("publish '%s' refused (%s)", name, _connected ? "too long" : "not connected");
+    return false;
+  }
+
+  if (publishHook)
+  {
+    return publishHook(name, data);
+  }
+
+  system_tick_t now = millis();
+  tokens = std::min(4.0, tokens + (now - refilled) / 1000.0);
+  refilled = now;
+
+  char line[400];
+  snprintf(line, sizeof(line), "publish %s %s%s\n", name, data, (tokens < 1) ? " (rate limited; dropped by the cloud)" : "");
+  output(line);
+  if (tokens >= 1)
+  {
+    tokens -= 1;
+  }
+
+  return true;
+}
+
+const bool
+ParticleClass::function(const char *name, std::function<int(String)> function)
+{
+  if ((strlen(name) > 12) || ((functions.size() >= 15) && !functions.count(name)))
+  {
+    Log.error("cannot register function '%s': names are at most 12 characters, and at most 15 functions", name);
+    return false;
+  }
+  functions[name] = function;
+
+  return true;
+}
+
+const bool
+waitForCondition(std::function<bool()> condition, const system_tick_t timeout)
+{
+  system_tick_t start = millis();
+
+  while (!condition())
+  {
+    if (millis() - start >= timeout)
+    {
+      return false;
+    }
+    delay(1);
+  }
+
+  return true;
+}
+
+// network
+
+IPAddress
+WiFiClass::resolve(const char *host)
+{
+  struct addrinfo hints;
+  struct addrinfo *found = NULL;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  if (getaddrinfo(host, NULL, &hints, &found) || !found)
+  {
+    return IPAddress();
+  }
+
+  IPAddress address(ntohl(((struct sockaddr_in *) found->ai_addr)->sin_addr.s_addr));
+  freeaddrinfo(found);
+
+  return address;
+}
+
+static struct sockaddr_in
+socketAddress(const IPAddress address, const uint16_t port)
+{
+  struct sockaddr_in result;
+
+  memset(&result, 0, sizeof(result));
+  result.sin_family = AF_INET;
+  result.sin_addr.s_addr = htonl(address._address);
+  result.sin_port = htons(port);
+
+  return result;
+}
+
+const int
+TCPClient::connect(const char *host, const uint16_t port)
+{
+  IPAddress address = WiFi.resolve(host);
+
+  return address ? connect(address, port) : 0;
+}
+
+const int
+TCPClient::connect(const IPAddress address, const uint16_t port)
+{
+  stop();
+
+  struct sockaddr_in peer = socketAddress(address, port);
+  struct timeval timeout = { 5, 0 };
+  _fd = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  if (::connect(_fd, (struct sockaddr *) &peer, sizeof(peer)) < 0)
+  {
+    stop();
+    return 0;
+  }
+
+  return 1;
+}
+
+const uint8_t
+TCPClient::connected()
+{
+  if (_fd < 0)
+  {
+    return 0;
+  }
+
+  // still connected while unread data remains, as on the device
+  uint8_t next;
+  ssize_t peeked = recv(_fd, &next, 1, MSG_PEEK | MSG_DONTWAIT);
+
+  return (peeked > 0) || ((peeked < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)));
+}
+
+const size_t
+TCPClient::write(const uint8_t *data, const size_t length)
+{
+  if (_fd < 0)
+  {
+    return -1;
+  }
+
+  return send(_fd, data, length, MSG_NOSIGNAL);
+}
+
+const int
+TCPClient::available()
+{
+  int pending = 0;
+
+  if ((_fd < 0) || (ioctl(_fd, FIONREAD, &pending) < 0))
+  {
+    return 0;
+  }
+
+  return pending;
+}
+
+const int
+TCPClient::read()
+{
+  uint8_t next;
+
+  return (read(&next, 1) == 1) ? next : -1;
+}
+
+const int
+TCPClient::read(uint8_t *data, const size_t length)
+{
+  ssize_t got = (_fd < 0) ? -1 : recv(_fd, data, length, MSG_DONTWAIT);
+
+  return (got > 0) ? got : -1;
+}
+
+void
+TCPClient::stop()
+{
+  if (_fd >= 0)
+  {
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+const uint8_t
+UDP::begin(const uint16_t port)
+{
+  stop();
+
+  struct sockaddr_in local = socketAddress(IPAddress(), port);
+  _fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (bind(_fd, (struct sockaddr *) &local, sizeof(local)) < 0)
+  {
+    stop();
+    return 0;
+  }
+
+  return 1;
+}
+
+void
+UDP::stop()
+{
+  if (_fd >= 0)
+  {
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+const int
+UDP::sendPacket(const uint8_t *data, const size_t length, const IPAddress address, const uint16_t port)
+{
+  struct sockaddr_in peer = socketAddress(address, port);
+
+  return (_fd < 0) ? -1 : sendto(_fd, data, length, 0, (struct sockaddr *) &peer, sizeof(peer));
+}
+
+// the board
+
+void
+Simulation::attachSpi(const uint16_t chipSelect, SpiDevice *device)
+{
+  if (chipSelect < pins)
+  {
+    spiDevices[chipSelect] = device;
+    levels[chipSelect] = HIGH;
+  }
+}
+
+void
+Simulation::setPin(const uint16_t pin, const uint8_t level)
+{
+  if (pin >= pins)
+  {
+    return;
+  }
+
+  uint8_t was = levels[pin];
+  levels[pin] = level;
+  if (was == level)
+  {
+    return;
+  }
+  if (level == HIGH)
+  {
+    risingEdges[pin]++;
+  }
+
+  // the calling thread plays the interrupt: nothing else holding the interrupt lock can run meanwhile
+  std::lock_guard<std::recursive_mutex> masked(interrupts());
+  std::function<void()> handler;
+  {
+    std::lock_guard<std::mutex> guard(gpioLock);
+    InterruptMode mode = interruptModes[pin];
+    if ((mode == CHANGE) || ((mode == RISING) && (level == HIGH)) || ((mode == FALLING) && (level == LOW)))
+    {
+      handler = interruptHandlers[pin];
+    }
+  }
+  if (handler)
+  {
+    handler();
+  }
+}
+
+void
+Simulation::setDeviceId(const char *id)
+{
+  deviceId = id;
+}
+
+const bool
+Simulation::callFunction(const char *name, const char *argument, int &result)
+{
+  std::map<std::string, std::function<int(String)> >::iterator found = functions.find(name);
+
+  if (found == functions.end())
+  {
+    return false;
+  }
+  result = found->second(String(argument));
+
+  return true;
+}
+
+void
+Simulation::onPublish(std::function<bool(const char *name, const char *data)> hook)
+{
+  publishHook = hook;
+}
+
+void
+Simulation::coldBoot()
+{
+  cloudOffset = Time._offset;
+  Time._offset = -currentSeconds();
+  Time._valid = false;
+}
+
+void
+Simulation::pressButton(const int milliseconds)
+{
+  if (System._handler && (System._events & button_status))
+  {
+    System._handler(button_status, 0, NULL);
+    delay(milliseconds);
+    System._handler(button_status, milliseconds, NULL);
+  }
+}
+
+void
+Simulation::useVirtualClock(std::function<void(const uint64_t micros)> hook)
+{
+  virtualMicros = 0;
+  onAdvance = hook;
+  virtualClock = true;
+}
+
+void
+Simulation::advance(const uint64_t micros)
+{
+  uint64_t target = virtualMicros + micros;
+
+  // the hook may step the clock up to the target itself, to deliver things at their own times, or spend time past
+  // it (an isr that blocks, say); either way the clock ends up at least at the target
+  if (onAdvance && !advancing)
+  {
+    advancing = true;
+    onAdvance(target);
+    advancing = false;
+  }
+  if (virtualMicros < target)
+  {
+    virtualMicros = target;
+  }
+}
+
+const uint64_t
+Simulation::now()
+{
+  return elapsedMicros();
+}
+
+void
+Simulation::shutdown()
+{
+  TimerDaemon::instance().stop();
+}
@@ -0,0 +1,54 @@
+/*
+ * Simulation.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "application.h"
+
+// a peripheral on the simulated spi bus; selected while its chip select pin is low
+class SpiDevice
+{
+public:
+  virtual ~SpiDevice() {}
+
+  virtual void select() = 0;
+  virtual const uint8_t transfer(const uint8_t data) = 0;
+  virtual void deselect() = 0;
+};
+
+// the board around the firmware: wiring for peripherals, and the console's view of the cloud and the button
+class Simulation
+{
+public:
+  static void attachSpi(const uint16_t chipSelect, SpiDevice *device);
+
+  // drives an input pin from a peripheral; a matching edge runs the attached handler on the calling thread
+  static void setPin(const uint16_t pin, const uint8_t level);
+
+  static void setDeviceId(const char *id);
+
+  // what the cloud does when a function is called or the setup button is pressed
+  static const bool callFunction(const char *name, const char *argument, int &result);
+  static void pressButton(const int milliseconds);
+  // starts the rtc at 1970 and not valid, as after a power loss, until the cloud sets it on Particle.connect()
+  static void coldBoot();
+  // publishes that pass the Device OS checks go to the hook instead of stdout; its result is publish()'s
+  static void onPublish(std::function<bool(const char *name, const char *data)> hook);
+
+  // replaces the wall clock (millis, micros, Time, delay) with one that only moves when advanced, starting at 0.
+  // for single-threaded replays: each advance runs the hook with the time being advanced to, while the clock still
+  // reads the time advanced from; the hook delivers whatever would have happened meanwhile (interrupts, timer
+  // callbacks), advancing to each one's time first.  stop the timer daemon first
+  static void useVirtualClock(std::function<void(const uint64_t micros)> hook);
+  static void advance(const uint64_t micros);
+  // microseconds since start, on whichever clock is in use
+  static const uint64_t now();
+
+  // stops the timer daemon; no callbacks run after this returns
+  static void shutdown();
+};
@@ -0,0 +1,202 @@
+/*
+ * SpiFlashSim.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SpiFlashSim.h"
+
+#define READ_DATA	0x03
+#define PAGE_PROGRAM	0x02
+#define SECTOR_ERASE	0x20
+#define WRITE_ENABLE	0x06
+#define WRITE_DISABLE	0x04
+#define READ_STATUS	0x05
+#define JEDEC_ID	0x9F
+
+SpiFlashSim::SpiFlashSim (const uint16_t chipSelect, const char *path, const uint32_t bytes, const bool fresh)
+: _chipSelect(chipSelect)
+, _fd(-1)
+, _bytes(bytes)
+, _erases(bytes / sectorSize, 0)
+, _budget(0)
+, _cut(false)
+, _position(0)
+, _command(0)
+, _address(0)
+, _writeEnabled(false)
+{
+  struct stat status;
+
+  _fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (_fd < 0)
+  {
+    perror(path);
+    return;
+  }
+
+  // blank whatever the file does not cover yet
+  off_t size = (!fresh && !fstat(_fd, &status)) ? status.st_size : 0;
+  if (size < (off_t) bytes)
+  {
+    std::vector<uint8_t> blank(sectorSize, 0xFF);
+    for (off_t at = size - size % sectorSize; at < (off_t) bytes; at += sectorSize)
+    {
+      if (pwrite(_fd, &blank[0], sectorSize, at) != sectorSize)
+      {
+	perror(path);
+	break;
+      }
+    }
+  }
+  Simulation::attachSpi(chipSelect, this);
+}
+
+SpiFlashSim::~SpiFlashSim ()
+{
+  Simulation::attachSpi(_chipSelect, NULL);
+  if (_fd >= 0)
+  {
+    close(_fd);
+  }
+}
+
+const bool
+SpiFlashSim::isOpen() const
+{
+  return _fd >= 0;
+}
+
+void
+SpiFlashSim::cutPowerAfter(const uint64_t bytes)
+{
+  _budget = bytes;
+  _cut = false;
+}
+
+const bool
+SpiFlashSim::powered() const
+{
+  return !_cut;
+}
+
+const std::vector<uint32_t> &
+SpiFlashSim::eraseCounts() const
+{
+  return _erases;
+}
+
+void
+SpiFlashSim::select()
+{
+  _position = 0;
+  _command = 0;
+  _address = 0;
+}
+
+const uint8_t
+SpiFlashSim::transfer(const uint8_t data)
+{
+  uint32_t position = _position++;
+  uint8_t value = 0xFF;
+
+  if (position == 0)
+  {
+    _command = data;
+    if (_command == WRITE_ENABLE)
+    {
+      _writeEnabled = !_cut;
+    }
+    else if (_command == WRITE_DISABLE)
+    {
+      _writeEnabled = false;
+    }
+    return 0xFF;
+  }
+
+  switch (_command)
+  {
+    case JEDEC_ID:
+      // winbond, spi nor, 32 Mbit
+      return (position == 1) ? 0xEF : (position == 2) ? 0x40 : (position == 3) ? 0x16 : 0xFF;
+
+    case READ_STATUS:
+      // never busy; write enable latch
+      return _writeEnabled ? 0x02 : 0x00;
+
+    case READ_DATA:
+    case PAGE_PROGRAM:
+    case SECTOR_ERASE:
+      if (position <= 3)
+      {
+	_address = ((_address << 8) | data) % _bytes;
+	return 0xFF;
+      }
+      if (_command == READ_DATA)
+      {
+	if (pread(_fd, &value, 1, _address) != 1)
+	{
+	  value = 0xFF;
+	}
+	_address = (_address + 1) % _bytes;
+      }
+      else if ((_command == PAGE_PROGRAM) && _writeEnabled)
+      {
+	// programming only clears bits
+	uint8_t current = 0xFF;
+	if (pread(_fd, &current, 1, _address) == 1)
+	{
+	  (void) change(_address, current & data);
+	}
+	_address = (_address & ~(pageSize - 1)) | ((_address + 1) & (pageSize - 1));
+      }
+      return value;
+
+    default:
+      return 0xFF;
+  }
+}
+
+void
+SpiFlashSim::deselect()
+{
+  if ((_command == SECTOR_ERASE) && _writeEnabled && (_position >= 4))
+  {
+    uint32_t sector = _address / sectorSize;
+    _erases[sector]++;
+    if (!_budget && !_cut)
+    {
+      std::vector<uint8_t> blank(sectorSize, 0xFF);
+      (void) pwrite(_fd, &blank[0], sectorSize, sector * sectorSize);
+    }
+    for (uint32_t i = 0; _budget && (i < sectorSize); i++)
+    {
+      (void) change(sector * sectorSize + i, 0xFF);
+    }
+  }
+  if ((_command == PAGE_PROGRAM) || (_command == SECTOR_ERASE))
+  {
+    _writeEnabled = false;
+  }
+}
+
+const bool
+SpiFlashSim::change(const uint32_t address, const uint8_t value)
+{
+  if (_cut)
+  {
+    return false;
+  }
+
+  bool changed = (pwrite(_fd, &value, 1, address) == 1);
+  if (_budget && !--_budget)
+  {
+    _cut = true;
+  }
+
+  return changed;
+}
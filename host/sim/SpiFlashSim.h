@@ -0,0 +1,58 @@
+/*
+ * SpiFlashSim.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "Simulation.h"
+
+// command-level model of a 25-series spi nor flash (a W25Q32 by its jedec id) kept in a file, so what is written
+// outlives the process as it would a reset: read, page program (clears bits only, wrapping within the page), 4 KB
+// sector erase, write enable and status.  programs and erases complete at once.  for power loss tests it can be
+// cut off partway through a program or erase, after which it takes no more changes; erase counts per sector show
+// how evenly the writer wears the part
+class SpiFlashSim : public SpiDevice
+{
+public:
+  enum
+  {
+    pageSize = 256,
+    sectorSize = 4096
+  };
+
+  // a new file is blank (all 0xFF); 'fresh' blanks an existing one
+  SpiFlashSim (const uint16_t chipSelect, const char *path, const uint32_t bytes, const bool fresh = false);
+  virtual ~SpiFlashSim ();
+
+  const bool isOpen() const;
+  // after this many more bytes programmed or erased the power fails: the rest of that operation and everything after
+  // it is lost.  0 restores power
+  void cutPowerAfter(const uint64_t bytes);
+  const bool powered() const;
+  const std::vector<uint32_t> &eraseCounts() const;
+
+  virtual void select();
+  virtual const uint8_t transfer(const uint8_t data);
+  virtual void deselect();
+
+protected:
+  const bool change(const uint32_t address, const uint8_t value);
+
+  uint16_t _chipSelect;
+  int _fd;
+  uint32_t _bytes;
+  std::vector<uint32_t> _erases;
+  uint64_t _budget;
+  bool _cut;
+
+  // the transaction in progress
+  uint32_t _position;
+  uint8_t _command;
+  uint32_t _address;
+  bool _writeEnabled;
+};
@@ -0,0 +1,364 @@
+/*
+ * application.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * host stand-in for Device OS's application.h: the slice of the Particle API the firmware uses (spi, gpio and
+ * interrupts, software timers, time, logging, the cloud and the network), implemented on posix in Particle.cpp.
+ * the firmware sources compile unchanged against it; the peripherals behind the bus live in Simulation.h
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <type_traits>
+
+typedef uint8_t byte;
+typedef uint32_t system_tick_t;
+
+#define retained
+#define SYSTEM_THREAD(state)
+#define SYSTEM_MODE(mode)
+#define STARTUP(code)
+
+// interrupts are delivered on peripheral threads while holding this lock, so holding it is "interrupts disabled"
+void lockInterrupts();
+void unlockInterrupts();
+
+class AtomicSection
+{
+public:
+  AtomicSection() : _once(true) { lockInterrupts(); }
+  ~AtomicSection() { unlockInterrupts(); }
+
+  bool _once;
+};
+
+#define ATOMIC_BLOCK() for (AtomicSection _atomic; _atomic._once; _atomic._once = false)
+#define SINGLE_THREADED_BLOCK() ATOMIC_BLOCK()
+
+class String : public std::string
+{
+public:
+  String() {}
+  String(const char *text) : std::string(text) {}
+  String(const std::string &text) : std::string(text) {}
+
+  operator const char *() const { return c_str(); }
+};
+
+// gpio
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+enum InterruptMode { CHANGE, RISING, FALLING };
+
+#define LOW 0
+#define HIGH 1
+
+enum
+{
+  D0 = 0, D1, D2, D3, D4, D5, D6, D7,
+  A0 = 10, A1, A2, A3, A4, A5, A6, A7,
+  RGBR, RGBG, RGBB
+};
+#define SS A2
+
+void pinMode(const uint16_t pin, const PinMode mode);
+void digitalWrite(const uint16_t pin, const uint8_t value);
+const int32_t digitalRead(const uint16_t pin);
+const bool attachInterrupt(const uint16_t pin, std::function<void()> handler, const InterruptMode mode);
+void detachInterrupt(const uint16_t pin);
+
+template <typename T>
+const bool attachInterrupt(const uint16_t pin, void (T::*handler)(), T *instance, const InterruptMode mode)
+{
+  return attachInterrupt(pin, std::bind(handler, instance), mode);
+}
+
+// spi; transfers go to the peripheral whose chip select is low
+#define SPI_MODE0 0x00
+#define MSBFIRST 1
+
+class SPIClass
+{
+public:
+  void begin();
+  void setDataMode(const uint8_t mode);
+  void setBitOrder(const uint8_t order);
+  const uint8_t transfer(const uint8_t data);
+};
+extern SPIClass SPI;
+
+// timing
+const system_tick_t millis();
+const system_tick_t micros();
+void delay(const system_tick_t milliseconds);
+void delayMicroseconds(const unsigned int microseconds);
+
+// Device OS runs every software timer on one daemon thread; so does this
+class Timer
+{
+public:
+  typedef std::function<void()> timer_callback_fn;
+
+  Timer(const unsigned int period, timer_callback_fn callback, const bool oneShot = false);
+
+  template <typename T>
+  Timer(const unsigned int period, void (T::*handler)(), T &instance, const bool oneShot = false)
+  : Timer(period, std::bind(handler, &instance), oneShot)
+  {
+  }
+
+  virtual ~Timer();
+
+  void start();
+  void stop();
+  void reset();
+  void changePeriod(const unsigned int period);
+  const bool isActive() const;
+  void dispose();
+
+  void startFromISR() { start(); }
+  void stopFromISR() { stop(); }
+  void resetFromISR() { reset(); }
+  void changePeriodFromISR(const unsigned int period) { changePeriod(period); }
+
+  timer_callback_fn _callback;
+  unsigned int _period;
+  bool _oneShot;
+  bool _active;
+  uint64_t _due;
+};
+
+// threads; Device OS runs the function once on a task of its own, here a detached std::thread
+typedef int os_thread_prio_t;
+#define OS_THREAD_PRIORITY_DEFAULT 2
+#define OS_THREAD_STACK_SIZE_DEFAULT 3072
+
+class Thread
+{
+public:
+  Thread(const char *name, std::function<void()> function, const os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT,
+	 const size_t stackSize = OS_THREAD_STACK_SIZE_DEFAULT);
+};
+
+// time; the rtc is the wall clock, utc
+#define TIME_FORMAT_ISO8601_FULL "%Y-%m-%dT%H:%M:%S%z"
+
+class TimeClass
+{
+public:
+  TimeClass();
+
+  const time_t now() const;
+  void setTime(const time_t when);
+  const bool isValid() const;
+  const int hour(const time_t when) const;
+  const int minute(const time_t when) const;
+  const int second(const time_t when) const;
+  const int day(const time_t when) const;
+  const int month(const time_t when) const;
+  const int year(const time_t when) const;
+  const int year() const;
+  String format(const time_t when, const char *format) const;
+
+  int64_t _offset;
+  bool _valid;	// set by setTime() or a cloud connection; see Simulation::coldBoot
+};
+extern TimeClass Time;
+
+// logging; the level is set by the SerialLogHandler, lines go to stdout like the device's serial log
+enum LogLevel
+{
+  LOG_LEVEL_ALL = 1,
+  LOG_LEVEL_TRACE = 1,
+  LOG_LEVEL_INFO = 30,
+  LOG_LEVEL_WARN = 40,
+  LOG_LEVEL_ERROR = 50,
+  LOG_LEVEL_NONE = 70
+};
+
+class Logger
+{
+public:
+  Logger() : _level(LOG_LEVEL_INFO) {}
+
+  // the firmware formats uint32_t with %lu, which is right on arm but not here; widening every integer to 64 bits
+  // makes %d, %u and %lu all read correctly on lp64 hosts
+  template <typename... Args> void trace(const char *format, Args... args) const { log(LOG_LEVEL_TRACE, format, widen(args)...); }
+  template <typename... Args> void info(const char *format, Args... args) const { log(LOG_LEVEL_INFO, format, widen(args)...); }
+  template <typename... Args> void warn(const char *format, Args... args) const { log(LOG_LEVEL_WARN, format, widen(args)...); }
+  template <typename... Args> void error(const char *format, Args... args) const { log(LOG_LEVEL_ERROR, format, widen(args)...); }
+
+  const bool isLevelEnabled(const int level) const { return level >= _level; }
+  void log(const int level, const char *format, ...) const;
+
+  int _level;
+
+private:
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, long long>::type widen(const T value) { return value; }
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, unsigned long long>::type widen(const T value) { return value; }
+  template <typename T>
+  static typename std::enable_if<!std::is_integral<T>::value, T>::type widen(const T value) { return value; }
+};
+extern Logger Log;
+
+class SerialLogHandler
+{
+public:
+  SerialLogHandler(const LogLevel level);
+};
+
+#define HEX 16
+#define DEC 10
+
+class SerialClass
+{
+public:
+  void begin(const int baud);
+  void flush();
+  void print(const char *text);
+  void println(const char *text);
+  void println(const int value, const int base = DEC);
+};
+extern SerialClass Serial;
+
+// system
+typedef uint32_t system_event_t;
+#define button_status 0x08
+#define FEATURE_RETAINED_MEMORY 1
+#define SLEEP_MODE_DEEP 1
+
+class SystemClass
+{
+public:
+  typedef void (*event_handler_t)(system_event_t event, int data, void *pointer);
+
+  void on(const system_event_t events, event_handler_t handler);
+  void enableFeature(const int feature);
+  String deviceID() const;
+  const uint32_t ticks() const;
+  const uint32_t ticksPerMicrosecond() const;
+  void reset();
+  void sleep(const int mode, const long seconds);
+  void sleep(const uint16_t wakeUpPin, const InterruptMode edgeTriggerMode);
+
+  event_handler_t _handler;
+  system_event_t _events;
+};
+extern SystemClass System;
+
+uint32_t HAL_RNG_GetRandomNumber();
+
+// the cloud; functions are called from the simulator console, publishes are printed
+class ParticleClass
+{
+public:
+  ParticleClass() : _connected(false) {}
+
+  const bool connected() const { return _connected; }
+  void connect();
+  void disconnect();
+  const bool syncTimeDone() const { return true; }
+  const bool publish(const char *name, const char *data);
+  const bool function(const char *name, std::function<int(String)> function);
+
+  template <typename T>
+  const bool function(const char *name, int (T::*handler)(String), T *instance)
+  {
+    return function(name, std::bind(handler, instance, std::placeholders::_1));
+  }
+
+  bool _connected;
+};
+extern ParticleClass Particle;
+
+const bool waitForCondition(std::function<bool()> condition, const system_tick_t timeout);
+#define waitFor(condition, timeout) waitForCondition([&]() { return (condition)(); }, (timeout))
+
+// network
+class IPAddress
+{
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(const uint8_t a, const uint8_t b, const uint8_t c, const uint8_t d) : _address((a << 24) | (b << 16) | (c << 8) | d) {}
+  IPAddress(const uint32_t address) : _address(address) {}
+
+  operator bool() const { return _address != 0; }
+
+  uint32_t _address;	// host order
+};
+
+class TCPClient
+{
+public:
+  TCPClient() : _fd(-1) {}
+  ~TCPClient() { stop(); }
+
+  const int connect(const char *host, const uint16_t port);
+  const int connect(const IPAddress address, const uint16_t port);
+  const uint8_t connected();
+  const size_t write(const uint8_t *data, const size_t length);
+  const int available();
+  const int read();
+  const int read(uint8_t *data, const size_t length);
+  void stop();
+
+private:
+  int _fd;
+};
+
+class UDP
+{
+public:
+  UDP() : _fd(-1) {}
+  ~UDP() { stop(); }
+
+  const uint8_t begin(const uint16_t port);
+  void stop();
+  const int sendPacket(const uint8_t *data, const size_t length, const IPAddress address, const uint16_t port);
+
+private:
+  int _fd;
+};
+
+class WiFiClass
+{
+public:
+  IPAddress resolve(const char *host);
+};
+extern WiFiClass WiFi;
+
+// stm32 clock tree, flash controller and rgb led; accepted and ignored
+#define RCC_HCLK_Div1 0
+#define RCC_SYSCLK_Div64 0
+#define FLASH_ACR_PRFTEN 0x10
+
+inline void RCC_PCLK1Config(const uint32_t) {}
+inline void RCC_PCLK2Config(const uint32_t) {}
+inline void RCC_HCLKConfig(const uint32_t) {}
+inline void SystemCoreClockUpdate() {}
+inline void SysTick_Configuration() {}
+
+typedef struct FlashRegisters
+{
+  volatile uint32_t ACR;
+} FlashRegisters;
+extern FlashRegisters *FLASH;
+
+class RGBClass
+{
+public:
+  void control(const bool) {}
+  void color(const int, const int, const int) {}
+};
+extern RGBClass RGB;
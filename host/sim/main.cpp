@@ -0,0 +1,139 @@
+/*
+ * main.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * the firmware as a linux process: setup() once, then loop() until the run time is up, with a simulated LIS331 on
+ * the spi bus (chip select SS, INT1 wired to A1 as on the board) and the upload session pointed at a local ingestd
+ * or receiver.  commands on stdin are handled between loop() passes, as cloud calls are on the device:
+ *
+ *   <function> <argument>   call a Particle.function, e.g. 'wire-format acked'
+ *   shake <seconds>         move the accelerometer
+ *   button                  press and release the setup button
+ *
+ * -c boots cold, with the rtc unset, in the firmware's low power mode: the cloud is only connected (which sets the
+ * rtc) once uploads are waiting on it
+ *
+ *   make -C host && host/build/moovit [-u [tcp://|udp://]host:port] [-i device id] [-t seconds] [-s shake seconds] [-c]
+ */
+
+#include <deque>
+#include <getopt.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Lis331Sim.h"
+#include "Simulation.h"
+
+void setup();
+void loop();
+extern bool savePower;
+
+static std::mutex commandLock;
+static std::deque<std::string> commands;
+
+static void
+readConsole()
+{
+  std::string line;
+
+  while (std::getline(std::cin, line))
+  {
+    std::lock_guard<std::mutex> guard(commandLock);
+    commands.push_back(line);
+  }
+}
+
+static void
+runCommand(const std::string &line, Lis331Sim &accelerometer)
+{
+  size_t space = line.find(' ');
+  std::string name = line.substr(0, space);
+  std::string argument = (space == std::string::npos) ? "" : line.substr(space + 1);
+  int result;
+
+  if (name.empty())
+  {
+    return;
+  }
+  if (name == "shake")
+  {
+    accelerometer.shake(atof(argument.c_str()));
+  }
+  else if (name == "button")
+  {
+    Simulation::pressButton(100);
+  }
+  else if (Simulation::callFunction(name.c_str(), argument.c_str(), result))
+  {
+    printf("%s(%s) returned %d\n", name.c_str(), argument.c_str(), result);
+  }
+  else
+  {
+    printf("no function '%s'\n", name.c_str());
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *endpoint = "tcp://127.0.0.1:32768";
+  double seconds = 0;
+  double shake = 0;
+  int option;
+
+  while ((option = getopt(argc, argv, "u:i:t:s:c")) != -1)
+  {
+    switch (option)
+    {
+      case 'u': endpoint = optarg; break;
+      case 'i': Simulation::setDeviceId(optarg); break;
+      case 't': seconds = atof(optarg); break;
+      case 's': shake = atof(optarg); break;
+      case 'c':
+	savePower = true;
+	Simulation::coldBoot();
+	break;
+      default:
+	fprintf(stderr, "usage: %s [-u [tcp://|udp://]host:port] [-i device id] [-t seconds] [-s shake seconds] [-c]\n", argv[0]);
+	return 1;
+    }
+  }
+
+  Lis331Sim accelerometer(SS, A1);
+  accelerometer.start();
+  accelerometer.shake(shake);
+
+  setup();
+
+  // never the production endpoint from a workstation
+  int result;
+  Simulation::callFunction("upload-host", endpoint, result);
+
+  std::thread console(readConsole);
+  console.detach();
+
+  system_tick_t start = millis();
+  while ((seconds <= 0) || (millis() - start < seconds * 1000))
+  {
+    loop();
+
+    std::deque<std::string> pending;
+    {
+      std::lock_guard<std::mutex> guard(commandLock);
+      pending.swap(commands);
+    }
+    for (std::deque<std::string>::const_iterator i = pending.begin(); i != pending.end(); ++i)
+    {
+      runCommand(*i, accelerometer);
+    }
+  }
+
+  accelerometer.stop();
+  Simulation::shutdown();
+  fflush(stdout);
+
+  return 0;
+}
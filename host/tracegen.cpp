@@ -0,0 +1,208 @@
+/*
+ * tracegen.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: rhb
+ *
+ * makes traces for host/replay, either from what a device actually uploaded (an ingestd csv file; entries keep their
+ * microseconds, except that entries from firmware that only kept whole seconds are spread evenly across their second)
+ * or from a deployment profile:
+ *
+ *   pets       mostly asleep; short bursts of play every few minutes
+ *   people     walks of several minutes between long stretches of sitting
+ *   machinery  vibrating all the time
+ *
+ * while active, the accelerometer interrupts about once a second (the interrupt is re-armed after 1 s) and each
+ * interrupt starts a second of streaming at the 10 ms streaming timer period
+ *
+ *   g++ -O2 -I.. -o tracegen tracegen.cpp ../WireFormat.cpp
+ *   ./tracegen -p pets|people|machinery [-d seconds] [-r seed] > pets.trace
+ *   ./tracegen -c device.csv > device.trace
+ */
+
+#include <math.h>
+#include <random>
+#include <stdlib.h>
+#include <unistd.h>
+#include "Trace.h"
+#include "WireFormat.h"
+
+typedef struct Profile
+{
+  const char *_name;
+  double _activeSeconds;	// mean length of an active stretch
+  double _restSeconds;		// mean gap between them; 0 for always active
+  double _amplitude;		// g
+  double _frequency;		// Hz
+  double _jerk;			// g of random jolts on top
+} Profile;
+
+static const Profile profiles[] =
+{
+  { "pets", 20, 300, 0.8, 3, 0.5 },
+  { "people", 300, 1200, 0.3, 2, 0.1 },
+  { "machinery", 3600, 0, 0.2, 47, 0.05 }
+};
+
+static int16_t
+counts(const double g)
+{
+  // ±6 g full scale, 12 significant bits left-justified, as the firmware configures the LIS331
+  double value = g / 6 * 32768;
+  value = (value > 32767) ? 32767 : (value < -32768) ? -32768 : value;
+
+  return ((int16_t) value) & ~0xF;
+}
+
+static TraceEvent
+sample(const Profile &profile, const uint64_t micros, const char kind, std::mt19937 &random)
+{
+  std::normal_distribution<double> noise(0, 0.01);
+  std::normal_distribution<double> jolt(0, profile._jerk);
+  double t = micros / 1e6;
+  TraceEvent event;
+
+  event._micros = micros;
+  event._kind = kind;
+  event._x = counts(profile._amplitude * sin(2 * M_PI * profile._frequency * t) + jolt(random) + noise(random));
+  event._y = counts(profile._amplitude * 0.5 * cos(2 * M_PI * profile._frequency * t) + jolt(random) + noise(random));
+  event._z = counts(1 + jolt(random) + noise(random));
+
+  return event;
+}
+
+static void
+generate(const Profile &profile, const double seconds, const unsigned int seed)
+{
+  std::mt19937 random(seed);
+  std::exponential_distribution<double> active(1 / profile._activeSeconds);
+  std::exponential_distribution<double> rest(1 / (profile._restSeconds ? profile._restSeconds : 1));
+  std::uniform_int_distribution<int> rearm(1000000, 1200000);
+  uint64_t end = seconds * 1e6;
+  uint64_t now = 0;
+
+  Trace::writeHeader(stdout, 1486922645);
+  while (now < end)
+  {
+    uint64_t stretch = profile._restSeconds ? now + active(random) * 1e6 : end;
+
+    while ((now < stretch) && (now < end))
+    {
+      Trace::write(stdout, sample(profile, now, 'i', random));
+
+      // a second of streaming, then the next interrupt once it is re-armed
+      uint64_t next = now + rearm(random);
+      for (uint64_t poll = now + 10000; (poll < now + 1000000) && (poll < end); poll += 10000)
+      {
+	Trace::write(stdout, sample(profile, poll, 's', random));
+      }
+      now = next;
+    }
+    now += profile._restSeconds ? rest(random) * 1e6 : 0;
+  }
+}
+
+static int
+convert(const char *path)
+{
+  FILE *in = fopen(path, "r");
+  if (!in)
+  {
+    perror(path);
+    return 1;
+  }
+
+  std::vector<MotionEntry> second;
+  time_t epoch = 0;
+  char line[128];
+
+  // entries are flushed a second at a time so they can be spread across it
+  while (true)
+  {
+    MotionEntry entry;
+    bool more = fgets(line, sizeof(line), in);
+    bool parsed = more && WireFormat::parseCsv(line, strlen(line), entry);
+
+    if (more && !parsed)
+    {
+      continue;
+    }
+    if (!second.empty() && (!more || (entry._time != second[0]._time)))
+    {
+      bool subSecond = false;
+      for (size_t i = 0; i < second.size(); i++)
+      {
+	subSecond |= (second[i]._micros != 0);
+      }
+      for (size_t i = 0; i < second.size(); i++)
+      {
+	TraceEvent event;
+	event._micros = (uint64_t) (second[i]._time - epoch) * 1000000 + (subSecond ? second[i]._micros : i * 1000000 / second.size());
+	event._kind = (second[i]._mode == 'i') ? 'i' : 's';
+	event._x = second[i]._x;
+	event._y = second[i]._y;
+	event._z = second[i]._z;
+	Trace::write(stdout, event);
+      }
+      second.clear();
+    }
+    if (!more)
+    {
+      break;
+    }
+    if (!epoch)
+    {
+      epoch = entry._time;
+      Trace::writeHeader(stdout, epoch);
+    }
+    if (entry._time < epoch)
+    {
+      fprintf(stderr, "skipping out of order entry: %s", line);
+      continue;
+    }
+    second.push_back(entry);
+  }
+  fclose(in);
+
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *profile = NULL;
+  const char *csv = NULL;
+  double seconds = 3600;
+  unsigned int seed = 1;
+  int option;
+
+  while ((option = getopt(argc, argv, "p:d:r:c:")) != -1)
+  {
+    switch (option)
+    {
+      case 'p': profile = optarg; break;
+      case 'd': seconds = atof(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      case 'c': csv = optarg; break;
+      default:
+	fprintf(stderr, "usage: %s -p pets|people|machinery [-d seconds] [-r seed] | -c device.csv\n", argv[0]);
+	return 1;
+    }
+  }
+
+  if (csv)
+  {
+    return convert(csv);
+  }
+  for (size_t i = 0; profile && (i < sizeof(profiles) / sizeof(profiles[0])); i++)
+  {
+    if (!strcmp(profile, profiles[i]._name))
+    {
+      generate(profiles[i], seconds, seed);
+      return 0;
+    }
+  }
+
+  fprintf(stderr, "usage: %s -p pets|people|machinery [-d seconds] [-r seed] | -c device.csv\n", argv[0]);
+  return 1;
+}
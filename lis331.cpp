@@ -94,18 +94,22 @@ LIS331::xyz(int16_t &x, int16_t &y, int16_t &z) const
 {
   // burst SPI read
   // A burst read of all three axis is required to guarantee all measurements correspond to same sample time
-  digitalWrite(_slaveSelectPin, LOW);
-  SPI.transfer(0x80 | 0x40 | OUT_X_L);  // read consecutive starting at low byte of x register
-  x = SPI.transfer(0x00);
-  x = x + (SPI.transfer(0x00) << 8);
+  // masked, as every transaction here: the spi flash shares the bus and is driven from loop()'s thread
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_slaveSelectPin, LOW);
+    SPI.transfer(0x80 | 0x40 | OUT_X_L);  // read consecutive starting at low byte of x register
+    x = SPI.transfer(0x00);
+    x = x + (SPI.transfer(0x00) << 8);
 
-  y = SPI.transfer(0x00);
-  y = y + (SPI.transfer(0x00) << 8);
+    y = SPI.transfer(0x00);
+    y = y + (SPI.transfer(0x00) << 8);
 
-  z = SPI.transfer(0x00);
-  z = z + (SPI.transfer(0x00) << 8);
+    z = SPI.transfer(0x00);
+    z = z + (SPI.transfer(0x00) << 8);
 
-  digitalWrite(_slaveSelectPin, HIGH);
+    digitalWrite(_slaveSelectPin, HIGH);
+  }
 
   if (Log.isLevelEnabled(LOG_LEVEL_TRACE))
   {
@@ -198,10 +202,13 @@ LIS331::SPIreadOneRegister(const byte regAddress) const
 {
   byte regValue = 0;
 
-  digitalWrite(_slaveSelectPin, LOW);
-  SPI.transfer(0x80 | regAddress);
-  regValue = SPI.transfer(0x00);
-  digitalWrite(_slaveSelectPin, HIGH);
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_slaveSelectPin, LOW);
+    SPI.transfer(0x80 | regAddress);
+    regValue = SPI.transfer(0x00);
+    digitalWrite(_slaveSelectPin, HIGH);
+  }
 
   return regValue;
 }
@@ -211,11 +218,14 @@ LIS331::SPIreadTwoRegisters(const byte regAddress) const
 {
   int16_t regValue = 0;
 
-  digitalWrite(_slaveSelectPin, LOW);
-  SPI.transfer(0x80 | 0x40 | regAddress);  // read consecutive starting at regAddress
-  regValue = SPI.transfer(0x00);
-  regValue += (SPI.transfer(0x00) << 8);
-  digitalWrite(_slaveSelectPin, HIGH);
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_slaveSelectPin, LOW);
+    SPI.transfer(0x80 | 0x40 | regAddress);  // read consecutive starting at regAddress
+    regValue = SPI.transfer(0x00);
+    regValue += (SPI.transfer(0x00) << 8);
+    digitalWrite(_slaveSelectPin, HIGH);
+  }
 
   return regValue;
 }
@@ -223,10 +233,13 @@ LIS331::SPIreadTwoRegisters(const byte regAddress) const
 void
 LIS331::SPIwriteOneRegister(const byte regAddress, const byte regValue) const
 {
-  digitalWrite(_slaveSelectPin, LOW);
-  SPI.transfer(regAddress);  // write specifies 0 in top bit, so just address
-  SPI.transfer(regValue);
-  digitalWrite(_slaveSelectPin, HIGH);
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_slaveSelectPin, LOW);
+    SPI.transfer(regAddress);  // write specifies 0 in top bit, so just address
+    SPI.transfer(regValue);
+    digitalWrite(_slaveSelectPin, HIGH);
+  }
 }
 
 void
@@ -235,9 +248,12 @@ LIS331::SPIwriteTwoRegisters(const byte regAddress, const int16_t regValue) cons
   byte regValueHigh = regValue >> 8;
   byte regValueLow = regValue;
 
-  digitalWrite(_slaveSelectPin, LOW);
-  SPI.transfer(regAddress);  // write specifies 0 in top bit, so just address
-  SPI.transfer(regValueLow);
-  SPI.transfer(regValueHigh);
-  digitalWrite(_slaveSelectPin, HIGH);
+  ATOMIC_BLOCK()
+  {
+    digitalWrite(_slaveSelectPin, LOW);
+    SPI.transfer(regAddress);  // write specifies 0 in top bit, so just address
+    SPI.transfer(regValueLow);
+    SPI.transfer(regValueHigh);
+    digitalWrite(_slaveSelectPin, HIGH);
+  }
 }